@@ -9,6 +9,15 @@
 #include "definitions.h"
 #include "x_errors_events.h"
 
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#if (pcntOPT_BENCH > 0)
+	#include "counter_engine.h"						// replay checks PulseEngine alongside
+#endif
+
+#include <assert.h>
+
 /* Design notes:
  * -------------
  * used for pulse counters, not scalar value sensors.
@@ -42,58 +51,1340 @@
 #define	debugPARAM					(debugFLAG_GLOBAL & debugFLAG & 0x4000)
 #define	debugRESULT					(debugFLAG_GLOBAL & debugFLAG & 0x8000)
 
+#if (debugTIMING > 0)
+	#include "esp_cpu.h"
+	#define	pcntTIME_START(x)		u32_t x = esp_cpu_get_cycle_count()
+	#define	pcntTIME_STOP(p, x)		vPulseCountTimeAdd(p, esp_cpu_get_cycle_count() - x)
+#else
+	#define	pcntTIME_START(x)
+	#define	pcntTIME_STOP(p, x)
+#endif
+
+#define	pcntRATE_TIMEOUT_MAX		(60 * 60 * 1000)	// mSec, well inside the u32_t uSec stamp wrap
+#define	pcntSGR_SIZE				16				// single SGR sequence, built by snprintfx()
+/* Worst case single channel report line set, all values at maximum width:
+ * header 80 + Min 7+60*5 + Hour 7+24*5 + Day 7+31*7 + Mon 7+12*7 + Year 20 + colour 4*9 */
+#if (pcntVIRT_MAX > 0)										// virtual: 127 values up to 11 chars + 2 spaces
+	#define	pcntREPORT_SIZE			2048
+#else
+	#define	pcntREPORT_SIZE			1024
+#endif
+#define	pcntEXPORT_SIZE				128				// export buffer, on stack
+#define	pcntVALUE_SIZE				32				// scaled value text, sign + 20 + point + 9 digits
+#define	pcntDEC_MAX					9
+#define	pcntSLOTS					(MINUTES_IN_HOUR + HOURS_IN_DAY + DAYS_IN_MONTH_MAX + MONTHS_IN_YEAR + 1)
+#define	pcntQTR_MINUTES				15
+#define	pcntQTR_PER_DAY				(MINUTES_IN_HOUR * HOURS_IN_DAY / pcntQTR_MINUTES)
+#define	pcntQTR_SLOTS				(pcntQTR_PER_DAY * pcntQTR_DAYS)
+#define	pcntCOLD_RECORD				(2 + MINUTES_IN_HOUR * 3)	// header + worst case payload
+
+static_assert(pcntCOLD_SIZE == 0 || pcntCOLD_SIZE >= pcntCOLD_RECORD, "pcntCOLD_SIZE too small for one record") ;
+
 // ########################################## Structures ###########################################
 
+/* Running counts, all the ISR touches. History buckets are held separately per channel,
+ * either dense or as sparse (slot, value) pairs, and only ever change at rollover */
 typedef struct __attribute__((packed)) {
-	u8_t		MinTD,	Min[MINUTES_IN_HOUR] ;
-	u8_t 	HourTD, Hour[HOURS_IN_DAY] ;
-	u16_t	DayTD,	Day[DAYS_IN_MONTH_MAX] ;
-	u16_t	MonTD,	Mon[MONTHS_IN_YEAR] ;
+	u8_t		MinTD ;
+	u8_t 	HourTD ;
+	u16_t	DayTD ;
+	u16_t	MonTD ;
 	u32_t	YearTD,	Year ;
 } pulsecnt_t ;
 
+typedef struct __attribute__((packed)) {
+	u8_t 	Hour[HOURS_IN_DAY] ;
+	u16_t	Day[DAYS_IN_MONTH_MAX] ;
+	u16_t	Mon[MONTHS_IN_YEAR] ;
+	u8_t		Min[MINUTES_IN_HOUR] ;						// last, not allocated without pcntFEAT_MIN
+} pcntdense_t ;
+
+// Engineering unit scale, Val * Num / Den with Dec decimals, Den == 0 for raw counts
+typedef struct {
+	u32_t Num, Den ;
+	u8_t Dec ;
+} pcntscale_t ;
+
+typedef struct __attribute__((packed)) {
+	u8_t Slot ;											// flat slot number, sorted ascending
+	u16_t Val ;
+} pcntpair_t ;
+
+typedef struct {
+	u8_t Num, Cap ;
+	pcntpair_t Pair[] ;
+} pcntsparse_t ;
+
+typedef struct {
+	u32_t Sum, Min, Max ;
+	u8_t MaxIdx, MinIdx, Cnt, Div ;						// Div: Cnt or days in month for Day tier
+} pcntstat_t ;
+
+typedef struct {
+	u32_t Stamp[pcntRATE_SAMPLES] ;						// esp_timer uSec, indexed by YearTD
+	u32_t Base ;										// YearTD when enabled, first valid sample
+	u32_t Timeout ;										// uSec
+	u32_t Smooth ;										// mHz
+} pcntrate_t ;
+
+/* Sub-minute tier, only allocated for enabled channels which are linked into a list
+ * so neither the ISR nor the once a second tick touch any other channel */
+typedef struct pcntsec_t {
+	struct pcntsec_t * psNext ;
+	u8_t Ch ;
+	u8_t Period ;										// seconds per slot
+	u8_t Base ;											// MinTD at start of current slot
+	u8_t Last ;											// slot most recently closed, last of the minute if none yet
+	u8_t Slot[] ;										// 60 / Period counts, current minute
+} pcntsec_t ;
+
+/* Alarms of all channels in a single list, only walked at rollover and when servicing.
+ * Per pulse cost is the trip compare in pcntxtra_t, independent of the number of alarms */
+typedef struct pcntalarm_t {
+	struct pcntalarm_t * psNext ;
+	pcntalarmcb_t pfCB ;
+	void * pvArg ;
+	u32_t Limit ;
+	u8_t Ch ;
+	u8_t Tier ;
+	u8_t Fired ;										// callback done, until tier rollover
+} pcntalarm_t ;
+
+/* Replaced history block awaiting the end of reports, exports and deltas using it */
+typedef struct pcntretired_t {
+	struct pcntretired_t * psNext ;
+	void * pvBlock ;
+} pcntretired_t ;
+
+/* Per tier statistics, if pcntFEAT_STAT */
+typedef struct {
+	pcntstat_t sStat[pcntTIER_YEAR] ;					// running, period in progress
+	pcntstat_t sLast[pcntTIER_YEAR] ;					// latched at end of parent period
+} pcntstatset_t ;
+
+#if (pcntOPT_LEAK > 0)
+/* Continuous flow tracking, if pcntFEAT_LEAK */
+typedef struct {
+	u16_t FlowRun ;										// consecutive non zero minutes, saturates
+	u8_t FlowMin ;										// lowest minute of the hour in progress
+	u8_t FlowMinLast ;									// lowest minute of the last completed hour
+	u32_t NightTD ;										// night window in progress
+	u32_t NightLast ;									// per hour average of the last night window
+} pcntleak_t ;
+#endif
+
+#if (pcntTARIFFS > 0)
+/* Time of use accumulators, if pcntFEAT_TOU */
+typedef struct {
+	u32_t TouTD[pcntTARIFFS] ;							// billing month in progress
+	u32_t TouLast[pcntTARIFFS] ;						// last completed billing month
+} pcnttousum_t ;
+#endif
+
+/* Long term history, appended at month & year end, separate from the working tiers */
+typedef struct {
+	#if (pcntHIST_YEARS > 0)
+	u32_t Year[pcntHIST_YEARS] ;
+	#endif
+	#if (pcntHIST_MONTHS > 0)
+	u16_t Mon[pcntHIST_MONTHS] ;						// same width as MonTD
+	#endif
+} pcnthist_t ;
+
+/* Compressed cold history, records appended at hour/day/month end, oldest dropped when full:
+ *	[Tier << 6 | Count] [Length] Payload
+ * Payload is the Count child bucket values in time order as zigzag LEB128 varint deltas
+ * from the previous value, with a zero delta followed by a varint (run length - 1) */
+typedef struct {
+	u16_t Used ;
+	u8_t Buf[pcntCOLD_SIZE] ;
+} pcntcold_t ;
+
+/* Per channel derived state, maintained at rollover and kept out of pulsecnt_t
+ * so the ISR path and the persisted bucket layout are not affected */
+typedef struct {
+	u32_t Roll[pcntTIER_MON] ;							// sum of retained Min/Hour/Day buckets
+	u32_t Total ;										// all pulses persisted, modulo 2^32
+	pcntstatset_t * psStat ;							// if pcntFEAT_STAT
+	pcntrate_t * psRate ;								// NULL unless rate tracking enabled
+	pcntdense_t * psDense ;								// dense history, else
+	pcntsparse_t * psSparse ;							// sparse history, NULL if all 0
+	u8_t NonZero ;										// non zero Min..Mon buckets
+	u8_t Feat ;											// pcntFEAT_? allocated to this channel
+	u8_t Peak ;											// most pulses in a minute
+	pcntscale_t sScale ;
+	u8_t AlarmPend ;									// trip reached, service in task
+	u8_t Armed ;										// TripAt valid
+	u32_t TripAt ;										// YearTD at which the nearest alarm trips
+	u16_t Ovf[pcntTIER_NUM] ;							// TD counter wraps per tier
+	u32_t BackTD ;										// MinTD moved out while a step back is absorbed
+	#if (pcntQTR_DAYS > 0)
+	u16_t QtrTD ;										// quarter hour in progress
+	u16_t * pu16Qtr ;									// [pcntQTR_SLOTS] if pcntFEAT_QTR
+	#endif
+	#if (pcntCOLD_SIZE > 0)
+	pcntcold_t * psCold ;								// if pcntFEAT_COLD
+	#endif
+	#if (pcntOPT_LEAK > 0)
+	pcntleak_t * psLeak ;								// if pcntFEAT_LEAK
+	#endif
+	#if (pcntTARIFFS > 0)
+	pcnttousum_t * psTou ;								// if pcntFEAT_TOU
+	#endif
+	#if (pcntHIST_MONTHS > 0 || pcntHIST_YEARS > 0)
+	pcnthist_t * psHist ;								// if pcntFEAT_HIST
+	#endif
+	#if (pcntOPT_QUERY > 0)
+	u32_t * pu32Cum ;									// [pcntSLOTS] Total at the boundary which wrote the slot
+	#endif
+} pcntxtra_t ;
+
+typedef struct {
+	const char * pcName ;
+	u8_t Depth ;
+	u8_t Base ;											// first slot in flat numbering
+} pcnttier_t ;
+
+typedef struct {
+	pcntsink_t Sink ;
+	void * pvArg ;
+	int iRV ;
+	u16_t Len ;
+	u8_t Buf[pcntEXPORT_SIZE] ;
+} pcntwr_t ;
+
 // ####################################### Public variables ########################################
 
 
 // ####################################### Private variables #######################################
 
 pulsecnt_t * psPCdata ;
-static int LastMin = -1 ;
+static pcntxtra_t * psPCxtra ;
+static bool bPCback ;									// clock stepped behind last rollover
+static bool bPCcatch ;									// catching up after a forward step
+static pcnthealth_t sPChealth ;							// global counters only
+static u32_t pcntReaders ;								// report, export & delta in progress
+static pcntretired_t * psPCretired ;					// replaced history, freed once no reader active
 static u8_t pcntNumCh;
 
+#if (pcntVIRT_MAX > 0)
+/* Virtual channels follow the physical ones, pcntNumCh + n, and are evaluated on read */
+typedef struct {
+	u8_t Num ;
+	pcntterm_t Term[pcntVIRT_TERMS] ;
+	pcntscale_t sScale ;
+} pcntvirt_t ;
+
+static pcntvirt_t sPCvirt[pcntVIRT_MAX] ;
+static u8_t pcntVirtNum ;
+#define	pcntCH_ALL					(pcntNumCh + pcntVirtNum)
+#else
+#define	pcntCH_ALL					pcntNumCh
+#endif
+
+static const pcnttier_t sPCtier[pcntTIER_NUM] = {
+	[pcntTIER_MIN]	= { "Min :  ",	MINUTES_IN_HOUR,	0 },
+	[pcntTIER_HOUR]	= { "Hour:  ",	HOURS_IN_DAY,		MINUTES_IN_HOUR },
+	[pcntTIER_DAY]	= { "Day :  ",	DAYS_IN_MONTH_MAX,	MINUTES_IN_HOUR + HOURS_IN_DAY },
+	[pcntTIER_MON]	= { "Mon :  ",	MONTHS_IN_YEAR,		MINUTES_IN_HOUR + HOURS_IN_DAY + DAYS_IN_MONTH_MAX },
+	[pcntTIER_YEAR]	= { "Year:  ",	1,					pcntSLOTS - 1 },
+} ;
+
+static const char * const pcPCkey[pcntTIER_NUM] = { "min", "hour", "day", "mon", "year" } ;
+
+static char caPCreport[pcntREPORT_SIZE] ;
+static char caPCsgr[2][pcntSGR_SIZE] ;					// current bucket colour & reset
+
+static pcntsec_t * psPCsec ;							// channels with sub-minute tier enabled
+static pcntalarm_t * psPCalarm ;
+static portMUX_TYPE sPCmux = portMUX_INITIALIZER_UNLOCKED ;	// channel scale & tariff schedule updates
+static volatile bool bPCalarm ;							// any channel AlarmPend set
+
+
+#if (pcntHIST_MONTHS > 0 || pcntHIST_YEARS > 0)
+static u32_t u32PChistMon, u32PChistYear ;				// entries appended, ring head
+#endif
+
+#if (pcntQTR_DAYS > 0)
+static u32_t u32PCqseq[pcntQTR_SLOTS] ;					// sequence stamp per quarter hour slot
+static int pcntQtrLast = -1 ;							// slot most recently persisted
+#endif
+
+/* Bucket writes happen for all channels at the same rollover, so a single sequence
+ * stamp per slot (not per channel) records when every channel's bucket last changed */
+static u32_t pcntSeq ;
+static u32_t u32PCseq[pcntSLOTS] ;
+
+static u32_t pcntEpoch ;								// boundary time of the last rollover
+#if (pcntOPT_BENCH > 0)
+static u32_t u32PCrewrite ;								// replay check, rollovers not after the last
+#endif
+
+#if (pcntTARIFFS > 0)
+static const pcnttou_t * psPCtou ;						// caller owned schedule
+static u8_t pcntTouNum ;
+static u8_t pcntTouNow ;								// tariff of the minute in progress
+#endif
+
+#if (pcntOPT_QUERY > 0)
+static u32_t u32PCtime[pcntSLOTS] ;						// boundary time each slot was written
+#endif
+
+#if (debugTIMING > 0)
+static pcnttiming_t sPCtime[pcntTIME_NUM] ;
+static const char * const pcPCphase[pcntTIME_NUM] = {
+	"min", "hour", "day", "mend", "mon", "year", "inc", "report"
+} ;
+#endif
+
+// ########################################## Local functions ######################################
+
+#if (debugTIMING > 0)
+static void vPulseCountTimeAdd(int Phase, u32_t Cycles) {
+	pcnttiming_t * psT = &sPCtime[Phase] ;
+	int Bin = Cycles ? (32 - __builtin_clz(Cycles)) : 0 ;	// 2^(Bin-1) <= Cycles < 2^Bin
+	if (Bin >= pcntTIME_BINS) Bin = pcntTIME_BINS - 1 ;
+	++psT->Hist[Bin] ;
+	++psT->Count ;
+	psT->Sum += Cycles ;
+	if (Cycles > psT->Max) psT->Max = Cycles ;
+}
+#endif
+
+/**
+ * Locate slot in sparse pairs by binary search
+ * @return	index of pair holding Slot, else -(insert position) - 1
+ */
+static int xPulseCountSparseFind(pcntsparse_t * psS, int Slot) {
+	int Lo = 0, Hi = psS ? psS->Num - 1 : -1 ;
+	while (Lo <= Hi) {
+		int Mid = (Lo + Hi) / 2 ;
+		if (psS->Pair[Mid].Slot == Slot) return Mid ;
+		if (psS->Pair[Mid].Slot < Slot) Lo = Mid + 1 ; else Hi = Mid - 1 ;
+	}
+	return -Lo - 1 ;
+}
+
+static u32_t xPulseCountBucket(pulsecnt_t * psPC, int Tier, int Idx) {
+	if (Tier == pcntTIER_YEAR) return psPC->Year ;
+	pcntxtra_t * psPX = &psPCxtra[psPC - psPCdata] ;
+	pcntsparse_t * psS = psPX->psSparse ;				// each pointer read once, may change
+	pcntdense_t * psD = psPX->psDense ;
+	if (psD == NULL) {
+		int i = xPulseCountSparseFind(psS, sPCtier[Tier].Base + Idx) ;
+		return (i < 0) ? 0 : psS->Pair[i].Val ;
+	}
+	switch (Tier) {
+	case pcntTIER_MIN:	return (psPX->Feat & pcntFEAT_MIN) ? psD->Min[Idx] : 0 ;	// else not allocated
+	case pcntTIER_HOUR:	return psD->Hour[Idx] ;
+	case pcntTIER_DAY:	return psD->Day[Idx] ;
+	case pcntTIER_MON:	return psD->Mon[Idx] ;
+	default:			return 0 ;
+	}
+}
+
+static size_t xPulseCountDenseSize(int Feat) {
+	return sizeof(pcntdense_t) - ((Feat & pcntFEAT_MIN) ? 0 : MINUTES_IN_HOUR) ;
+}
+
+static void vPulseCountDenseSet(pcntdense_t * psD, int Slot, u32_t Val) {
+	int t = pcntTIER_MON ;
+	while (Slot < sPCtier[t].Base) --t ;
+	int Idx = Slot - sPCtier[t].Base ;
+	switch (t) {
+	case pcntTIER_MIN:	psD->Min[Idx] = Val ;	break ;
+	case pcntTIER_HOUR:	psD->Hour[Idx] = Val ;	break ;
+	case pcntTIER_DAY:	psD->Day[Idx] = Val ;	break ;
+	case pcntTIER_MON:	psD->Mon[Idx] = Val ;	break ;
+	default:			break ;
+	}
+}
+
+/* History blocks replaced at rollover may still be in use by a report, export or delta in
+ * another task (RCU style). The replacement is published first and the old block freed at
+ * once if no reader is active, else queued on psPCretired and freed at the first rollover
+ * with no reader active. The queue entry is allocated before the format changes so that a
+ * replaced block can always be queued, however many changes a slow reader spans. */
+static void vPulseCountReadEnter(void) { __atomic_add_fetch(&pcntReaders, 1, __ATOMIC_SEQ_CST) ; }
+static void vPulseCountReadExit(void) { __atomic_sub_fetch(&pcntReaders, 1, __ATOMIC_SEQ_CST) ; }
+
+static void vPulseCountRetire(pcntretired_t * psR, void * pvOld) {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST) ;			// replacement visible before readers checked
+	if (__atomic_load_n(&pcntReaders, __ATOMIC_SEQ_CST)) {
+		psR->pvBlock = pvOld ;
+		psR->psNext = psPCretired ;
+		psPCretired = psR ;
+	} else {
+		vRtosFree(pvOld) ;
+		vRtosFree(psR) ;
+	}
+}
+
+/**
+ * Free the queued blocks, at once if bForce else only with no reader active
+ */
+static void vPulseCountReclaim(bool bForce) {
+	if (psPCretired == NULL || (bForce == 0 && __atomic_load_n(&pcntReaders, __ATOMIC_SEQ_CST))) return ;
+	while (psPCretired) {
+		pcntretired_t * psR = psPCretired ;
+		psPCretired = psR->psNext ;
+		vRtosFree(psR->pvBlock) ;
+		vRtosFree(psR) ;
+	}
+}
+
+/**
+ * Store a bucket in sparse pairs, growing the pair array in steps and converting the
+ * channel to dense once more than pcntSPARSE_MAX buckets are non zero. Only called at
+ * rollover so the ISR never sees the format change. Without memory the channel stays
+ * sparse and a bucket that does not fit is dropped.
+ * @return	true if stored, false if dropped (the bucket remains 0)
+ */
+static bool xPulseCountSparseSet(pcntxtra_t * psPX, int Slot, u32_t Val) {
+	pcntsparse_t * psS = psPX->psSparse ;
+	int i = xPulseCountSparseFind(psS, Slot) ;
+	if (i >= 0) {
+		if (Val) {
+			psS->Pair[i].Val = Val ;
+		} else {										// remove pair
+			--psS->Num ;
+			memmove(&psS->Pair[i], &psS->Pair[i + 1], (psS->Num - i) * sizeof(pcntpair_t)) ;
+		}
+		return 1 ;
+	}
+	if (Val == 0) return 1 ;							// absent is already 0
+	i = -i - 1 ;
+	if (psS == NULL || psS->Num == psS->Cap) {
+		pcntretired_t * psR = psS ? pvRtosMalloc(sizeof(pcntretired_t)) : NULL ;
+		if (psS && psR == NULL) {
+			++sPChealth.NoMem ;
+			return 0 ;
+		}
+		int Cap = psS ? psS->Cap + pcntSPARSE_STEP : pcntSPARSE_STEP ;
+		if (Cap > pcntSPARSE_MAX) {						// busy, switch to dense
+			size_t Size = xPulseCountDenseSize(psPX->Feat) ;
+			pcntdense_t * psD = pvRtosMalloc(Size) ;
+			if (psD) {
+				memset(psD, 0, Size) ;
+				for (int j = 0; j < psS->Num; ++j)
+					vPulseCountDenseSet(psD, psS->Pair[j].Slot, psS->Pair[j].Val) ;
+				vPulseCountDenseSet(psD, Slot, Val) ;
+				psPX->psDense = psD ;
+				psPX->psSparse = NULL ;
+				vPulseCountRetire(psR, psS) ;
+				return 1 ;
+			}
+		}
+		pcntsparse_t * psN = (Cap <= UINT8_MAX) ? pvRtosMalloc(sizeof(pcntsparse_t) + Cap * sizeof(pcntpair_t)) : NULL ;
+		if (psN == NULL) {								// no memory, stay as is
+			if (psR) vRtosFree(psR) ;
+			++sPChealth.NoMem ;
+			return 0 ;
+		}
+		psN->Num = psS ? psS->Num : 0 ;
+		psN->Cap = Cap ;
+		if (psS) memcpy(psN->Pair, psS->Pair, psS->Num * sizeof(pcntpair_t)) ;
+		psPX->psSparse = psN ;
+		if (psS) vPulseCountRetire(psR, psS) ;
+		psS = psN ;
+	}
+	memmove(&psS->Pair[i + 1], &psS->Pair[i], (psS->Num - i) * sizeof(pcntpair_t)) ;
+	psS->Pair[i] = (pcntpair_t) { .Slot = Slot, .Val = Val } ;
+	++psS->Num ;
+	return 1 ;
+}
+
+/**
+ * Convert a dense channel back to sparse once it has become idle, called at day rollover
+ */
+static void vPulseCountSparseCheck(pulsecnt_t * psPC) {
+	pcntxtra_t * psPX = &psPCxtra[psPC - psPCdata] ;
+	if (psPX->psDense == NULL || psPX->NonZero > pcntSPARSE_MIN) return ;
+	pcntretired_t * psR = pvRtosMalloc(sizeof(pcntretired_t)) ;
+	if (psR == NULL) return ;							// no memory, stay dense
+	int Cap = psPX->NonZero ? ((psPX->NonZero + pcntSPARSE_STEP - 1) / pcntSPARSE_STEP) * pcntSPARSE_STEP : 0 ;
+	pcntsparse_t * psS = NULL ;
+	if (Cap) {
+		psS = pvRtosMalloc(sizeof(pcntsparse_t) + Cap * sizeof(pcntpair_t)) ;
+		if (psS == NULL) {								// no memory, stay dense
+			vRtosFree(psR) ;
+			return ;
+		}
+		psS->Num = 0 ;
+		psS->Cap = Cap ;
+		for (int t = (psPX->Feat & pcntFEAT_MIN) ? pcntTIER_MIN : pcntTIER_HOUR; t < pcntTIER_YEAR; ++t) {
+			for (int j = 0; j < sPCtier[t].Depth; ++j) {
+				u32_t Val = xPulseCountBucket(psPC, t, j) ;
+				if (Val) psS->Pair[psS->Num++] = (pcntpair_t) { .Slot = sPCtier[t].Base + j, .Val = Val } ;
+			}
+		}
+	}
+	pcntdense_t * psD = psPX->psDense ;
+	psPX->psSparse = psS ;
+	psPX->psDense = NULL ;
+	vPulseCountRetire(psR, psD) ;
+}
+
+static u32_t xPulseCountTD(pulsecnt_t * psPC, int Tier) {
+	switch (Tier) {
+	case pcntTIER_MIN:	return psPC->MinTD + psPCxtra[psPC - psPCdata].BackTD ;
+	case pcntTIER_HOUR:	return psPC->HourTD ;
+	case pcntTIER_DAY:	return psPC->DayTD ;
+	case pcntTIER_MON:	return psPC->MonTD ;
+	case pcntTIER_YEAR:	return psPC->YearTD ;
+	default:			return 0 ;
+	}
+}
+
+/**
+ * Weighted sum over the (physical) terms of virtual channel Ch of the values returned by
+ * pfTerm, accumulated as i64_t and saturated to the i32_t range returned
+ */
+static u32_t xPulseCountVirtSum(int Ch, u32_t (* pfTerm)(int, void *), void * pvArg) {
+	#if (pcntVIRT_MAX > 0)
+	pcntvirt_t * psV = &sPCvirt[Ch - pcntNumCh] ;
+	i64_t Sum = 0 ;
+	for (int i = 0; i < psV->Num; ++i)
+		Sum += (i64_t) psV->Term[i].Weight * pfTerm(psV->Term[i].Ch, pvArg) ;
+	if (Sum > INT32_MAX) Sum = INT32_MAX ;
+	else if (Sum < INT32_MIN) Sum = INT32_MIN ;
+	return (i32_t) Sum ;
+	#else
+	(void) Ch ; (void) pfTerm ; (void) pvArg ;
+	return 0 ;
+	#endif
+}
+
+static u32_t xPulseCountValTerm(int Ch, void * pvArg) {
+	int * piTS = pvArg ;
+	pulsecnt_t * psPC = &psPCdata[Ch] ;
+	return (piTS[1] < 0) ? xPulseCountTD(psPC, piTS[0]) : xPulseCountBucket(psPC, piTS[0], piTS[1]) ;
+}
+
+/**
+ * Running count (Slot < 0) or bucket of any channel, virtual channels as signed (i32_t) values
+ */
+static u32_t xPulseCountVal(int Ch, int Tier, int Slot) {
+	int iTS[2] = { Tier, Slot } ;
+	return (Ch < pcntNumCh) ? xPulseCountValTerm(Ch, iTS) : xPulseCountVirtSum(Ch, xPulseCountValTerm, iTS) ;
+}
+
+/**
+ * Recompute the YearTD value at which a channel, or all (-1), reaches the first alarm not
+ * yet fired, flag for service if one is already at or past its limit. Lock free: every tier
+ * TD moves in step with YearTD between rollovers, so a trip point taken while YearTD did not
+ * change is exact, and pulses passing it before the ISR sees it are caught below. O(alarms)
+ */
+static void vPulseCountAlarmArm(int Ch) {
+	for (int i = (Ch < 0) ? 0 : Ch; i < ((Ch < 0) ? pcntNumCh : Ch + 1); ++i) {
+		pulsecnt_t * psPC = &psPCdata[i] ;
+		pcntxtra_t * psPX = &psPCxtra[i] ;
+		u32_t Base, Left ;
+		bool bPend ;
+		do {
+			Base = __atomic_load_n(&psPC->YearTD, __ATOMIC_ACQUIRE) ;
+			Left = 0 ;
+			bPend = 0 ;
+			for (pcntalarm_t * psA = psPCalarm; psA; psA = psA->psNext) {
+				if (psA->Ch != i || psA->Fired) continue ;
+				u32_t TD = xPulseCountTD(psPC, psA->Tier) ;
+				if (TD >= psA->Limit) bPend = 1 ;
+				else if (Left == 0 || (psA->Limit - TD) < Left) Left = psA->Limit - TD ;
+			}
+		} while (Base != __atomic_load_n(&psPC->YearTD, __ATOMIC_ACQUIRE)) ;
+		if (Left) {
+			__atomic_store_n(&psPX->TripAt, Base + Left, __ATOMIC_RELAXED) ;
+			__atomic_store_n(&psPX->Armed, 1, __ATOMIC_RELEASE) ;
+			if ((i32_t) (__atomic_load_n(&psPC->YearTD, __ATOMIC_ACQUIRE) - (Base + Left)) >= 0) bPend = 1 ;
+		} else {
+			__atomic_store_n(&psPX->Armed, 0, __ATOMIC_RELEASE) ;
+		}
+		if (bPend) {
+			psPX->AlarmPend = 1 ;
+			bPCalarm = 1 ;
+		}
+	}
+}
+
+#if (pcntOPT_LEAK > 0)
+/**
+ * Continuous flow tracking, O(1) per channel per minute
+ * @param	Count	pulses in the minute just completed
+ * @param	Min		minute of the hour just completed
+ */
+static void vPulseCountFlow(pcntleak_t * psL, u8_t Count, int Min, bool bNight, bool bNightEnd) {
+	if (Count == 0) psL->FlowRun = 0 ;
+	else if (psL->FlowRun < 0xFFFF) ++psL->FlowRun ;
+	if (Min == 0 || Count < psL->FlowMin) psL->FlowMin = Count ;
+	if (Min == MINUTES_IN_HOUR - 1) psL->FlowMinLast = psL->FlowMin ;
+	if (bNight) psL->NightTD += Count ;
+	if (bNightEnd) {
+		psL->NightLast = psL->NightTD / pcntNIGHT_HOURS ;
+		psL->NightTD = 0 ;
+	}
+}
+#endif
+
+/**
+ * Persist a completed period value into a tier bucket, all bucket writes must come through here
+ */
+static void vPulseCountPersist(pulsecnt_t * psPC, int Tier, int Idx, u32_t Val) {
+	pcntxtra_t * psPX = &psPCxtra[psPC - psPCdata] ;
+	if (Tier == pcntTIER_MIN && (psPX->Feat & pcntFEAT_MIN) == 0)
+		return ;										// minute tier not kept for channel
+	int Slot = sPCtier[Tier].Base + Idx ;
+	if (Tier == pcntTIER_YEAR) {
+		psPC->Year = Val ;
+	} else {
+		u32_t Old = xPulseCountBucket(psPC, Tier, Idx) ;
+		if (psPX->psDense)
+			vPulseCountDenseSet(psPX->psDense, Slot, Val) ;
+		else if (xPulseCountSparseSet(psPX, Slot, Val) == 0)
+			return ;									// dropped, bucket & stamps as they were
+		if (Tier < pcntTIER_MON)						// rolling window, replace oldest with newest
+			psPX->Roll[Tier] += Val - Old ;
+		psPX->NonZero += (Val != 0) - (Old != 0) ;
+	}
+	u32PCseq[Slot] = pcntSeq ;
+	#if (pcntOPT_QUERY > 0)
+	/* Month end zeroing of Day[] also passes here, stamped with 23:59 it can never
+	 * match a day boundary in xPulseCountQuery() so these slots drop out of use */
+	if (psPX->pu32Cum) psPX->pu32Cum[Slot] = psPX->Total ;
+	u32PCtime[Slot] = pcntEpoch ;
+	#endif
+}
+
+static void vPulseCountClearTD(pulsecnt_t * psPC, int Tier) {
+	switch (Tier) {
+	case pcntTIER_MIN:	psPC->MinTD = 0 ; psPCxtra[psPC - psPCdata].BackTD = 0 ;	break ;
+	case pcntTIER_HOUR:	psPC->HourTD = 0 ;		break ;
+	case pcntTIER_DAY:	psPC->DayTD = 0 ;		break ;
+	case pcntTIER_MON:	psPC->MonTD = 0 ;		break ;
+	case pcntTIER_YEAR:	psPC->YearTD = 0 ;		break ;
+	default:			break ;
+	}
+}
+
+#if (pcntCOLD_SIZE > 0)
+static u8_t * pu8PulseCountVarint(u8_t * pU8, u32_t Val) {
+	while (Val > 0x7F) {
+		*pU8++ = (Val & 0x7F) | 0x80 ;
+		Val >>= 7 ;
+	}
+	*pU8++ = Val ;
+	return pU8 ;
+}
+
+static const u8_t * pu8PulseCountVarintGet(const u8_t * pU8, u32_t * pu32) {
+	u32_t Val = 0 ;
+	int Shift = 0 ;
+	do {
+		Val |= (u32_t) (*pU8 & 0x7F) << Shift ;
+		Shift += 7 ;
+	} while (*pU8++ & 0x80) ;
+	*pu32 = Val ;
+	return pU8 ;
+}
+
+/**
+ * Compress the Count child buckets of a just completed period into the channel's cold store.
+ * @param	Tier	child tier, values are read in time order ending with bucket Last
+ */
+static void vPulseCountColdAppend(pulsecnt_t * psPC, int Tier, int Last, int Count) {
+	u8_t Rec[pcntCOLD_RECORD] ;
+	u8_t * pU8 = &Rec[2] ;
+	u32_t Prev = 0 ;
+	for (int i = 0; i < Count; ) {
+		u32_t Val = xPulseCountBucket(psPC, Tier, (Last + 1 + i) % Count) ;
+		i32_t Delta = Val - Prev ;
+		Prev = Val ;
+		++i ;
+		if (Delta) {
+			pU8 = pu8PulseCountVarint(pU8, ((u32_t) Delta << 1) ^ (u32_t) (Delta >> 31)) ;
+			continue ;
+		}
+		int Run = 0 ;									// zero delta, count repeats
+		while (i < Count && xPulseCountBucket(psPC, Tier, (Last + 1 + i) % Count) == Prev) { ++Run ; ++i ; }
+		*pU8++ = 0 ;
+		pU8 = pu8PulseCountVarint(pU8, Run) ;
+	}
+	Rec[0] = (Tier << 6) | Count ;
+	Rec[1] = pU8 - &Rec[2] ;
+	int Len = pU8 - Rec ;
+	pcntcold_t * psC = psPCxtra[psPC - psPCdata].psCold ;
+	while (psC->Used + Len > pcntCOLD_SIZE) {
+		/* Release the oldest record of the tier using most space, so the frequent hourly
+		 * records can't flush out the day and month records */
+		int Own[pcntTIER_MON] = { 0 }, First[pcntTIER_MON] = { -1, -1, -1 } ;
+		for (int Ofs = 0; Ofs < psC->Used; Ofs += 2 + psC->Buf[Ofs + 1]) {
+			int t = psC->Buf[Ofs] >> 6 ;
+			if (First[t] < 0) First[t] = Ofs ;
+			Own[t] += 2 + psC->Buf[Ofs + 1] ;
+		}
+		int Max = pcntTIER_MIN ;
+		for (int t = pcntTIER_HOUR; t < pcntTIER_MON; ++t)
+			if (Own[t] > Own[Max]) Max = t ;
+		int Ofs = First[Max] ;
+		int Size = 2 + psC->Buf[Ofs + 1] ;
+		psC->Used -= Size ;
+		memmove(&psC->Buf[Ofs], &psC->Buf[Ofs + Size], psC->Used - Ofs) ;
+	}
+	memcpy(&psC->Buf[psC->Used], Rec, Len) ;
+	psC->Used += Len ;
+}
+#endif
+
+/**
+ * Persist TD count of a tier, update statistics of the tier and latch those of the child tier.
+ * @param	Div		number of child buckets the finished period should have had (month length
+ * 					for the Day tier), 0 to use the number actually persisted
+ */
+static void vPulseCountRollover(pulsecnt_t * psPC, int Tier, int Idx, int Div) {
+	pcntxtra_t * psPX = &psPCxtra[psPC - psPCdata] ;
+	u32_t Val = xPulseCountTD(psPC, Tier) ;
+	if (Tier == pcntTIER_MIN && Val > UINT8_MAX) Val = UINT8_MAX ;	// minute spanning a step back
+	vPulseCountPersist(psPC, Tier, Idx, Val) ;
+	vPulseCountClearTD(psPC, Tier) ;
+	pcntstatset_t * psSS = psPX->psStat ;
+	if (psSS && Tier < pcntTIER_YEAR) {					// accumulate running stats
+		pcntstat_t * psS = &psSS->sStat[Tier] ;
+		if (psS->Cnt == 0 || Val < psS->Min) { psS->Min = Val ; psS->MinIdx = Idx ; }
+		if (psS->Cnt == 0 || Val > psS->Max) { psS->Max = Val ; psS->MaxIdx = Idx ; }
+		psS->Sum += Val ;
+		++psS->Cnt ;
+	}
+	#if (pcntCOLD_SIZE > 0)
+	/* Compress minutes of hour, hours of day, days of month. Parent boundaries always
+	 * coincide with child bucket 0 being written last, so buckets 1..N-1,0 are in time order */
+	if (Tier > pcntTIER_MIN && Tier < pcntTIER_YEAR && psPX->psCold &&
+		(Tier != pcntTIER_HOUR || (psPX->Feat & pcntFEAT_MIN)))
+		vPulseCountColdAppend(psPC, Tier - 1, 0, (Tier == pcntTIER_MON && Div) ? Div : sPCtier[Tier-1].Depth) ;
+	#endif
+	if (Tier == pcntTIER_YEAR && psPX->psRate)			// YearTD restarts, so does ring index
+		psPX->psRate->Base = 0 ;
+	#if (pcntHIST_MONTHS > 0)
+	if (Tier == pcntTIER_MON && psPX->psHist)
+		psPX->psHist->Mon[(u32PChistMon - 1) % pcntHIST_MONTHS] = Val ;
+	#endif
+	#if (pcntHIST_YEARS > 0)
+	if (Tier == pcntTIER_YEAR && psPX->psHist)
+		psPX->psHist->Year[(u32PChistYear - 1) % pcntHIST_YEARS] = Val ;
+	#endif
+	if (psSS && Tier > pcntTIER_MIN) {					// parent period done, latch child stats
+		pcntstat_t * psS = &psSS->sStat[Tier-1] ;
+		psS->Div = Div ? Div : psS->Cnt ;
+		psSS->sLast[Tier-1] = *psS ;
+		memset(psS, 0, sizeof(pcntstat_t)) ;
+	}
+}
+
+/**
+ * Seconds since 1970-01-01 for a broken down time, no timezone or DST adjustment
+ */
+static u32_t xPulseCountEpoch(int Year, int Mon, int MDay, int Hour, int Min) {
+	Year += 1900 - (Mon < 2) ;							// days from civil, March based year
+	int Era = Year / 400 ;
+	int YoE = Year - Era * 400 ;
+	int DoY = (153 * (Mon < 2 ? Mon + 10 : Mon - 2) + 2) / 5 + MDay - 1 ;
+	int DoE = YoE * 365 + YoE / 4 - YoE / 100 + DoY ;
+	u32_t Days = Era * 146097 + DoE - 719468 ;
+	return Days * 86400 + Hour * 3600 + Min * 60 ;
+}
+
+static char * pcPulseCountStr(char * pC, const char * pcStr) {
+	while (*pcStr) *pC++ = *pcStr++ ;
+	return pC ;
+}
+
+/**
+ * Convert unsigned value to decimal, 2 digits per division using a pair lookup table.
+ * @param	pC		buffer to write into, no terminator added
+ * @param	Val		value to convert
+ * @return	pointer to first character after the last digit written
+ */
+static char * pcPulseCountU32toA(char * pC, u32_t Val) {
+	static const char caPairs[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899" ;
+	char caTmp[10] ;
+	char * pT = &caTmp[sizeof(caTmp)] ;
+	while (Val >= 100) {
+		u32_t Rem = (Val % 100) * 2 ;
+		Val /= 100 ;
+		*--pT = caPairs[Rem + 1] ;
+		*--pT = caPairs[Rem] ;
+	}
+	if (Val >= 10) {
+		*--pT = caPairs[Val * 2 + 1] ;
+		*--pT = caPairs[Val * 2] ;
+	} else {
+		*--pT = '0' + Val ;
+	}
+	while (pT < &caTmp[sizeof(caTmp)]) *pC++ = *pT++ ;
+	return pC ;
+}
+
+static const u32_t u32PCpow10[pcntDEC_MAX + 1] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+} ;
+
+static char * pcPulseCountPad(char * pC, u32_t Val, int Digits) {
+	while (Digits--) pC[Digits] = '0' + Val % 10, Val /= 10 ;
+	return pC ;
+}
+
+static char * pcPulseCountU64toA(char * pC, u64_t Val) {
+	if (Val <= 0xFFFFFFFF) return pcPulseCountU32toA(pC, Val) ;
+	pC = pcPulseCountU64toA(pC, Val / u32PCpow10[9]) ;
+	pcPulseCountPad(pC, Val % u32PCpow10[9], 9) ;
+	return pC + 9 ;
+}
+
+static pcntscale_t * psPulseCountScale(int Ch) {
+	#if (pcntVIRT_MAX > 0)
+	if (Ch >= pcntNumCh) return &sPCvirt[Ch - pcntNumCh].sScale ;
+	#endif
+	return &psPCxtra[Ch].sScale ;
+}
+
+/**
+ * Apply the channel scale with exact integer arithmetic, rounding half away from zero
+ * @param	pu64Int		receives the magnitude of the integer part
+ * @param	pu32Frac	receives the Dec decimals as an integer
+ * @return	Dec, or -1 if the channel has no scale (raw magnitude in pu64Int)
+ * @note	virtual channel values are signed, negative if the sign bit is set
+ */
+static int xPulseCountScaleSplit(int Ch, u32_t Val, bool * pbNeg, u64_t * pu64Int, u32_t * pu32Frac) {
+	*pbNeg = Ch >= pcntNumCh && (i32_t) Val < 0 ;
+	if (*pbNeg) Val = -Val ;
+	portENTER_CRITICAL_SAFE(&sPCmux) ;					// consistent with xPulseCountScale()
+	pcntscale_t sS = *psPulseCountScale(Ch) ;
+	portEXIT_CRITICAL_SAFE(&sPCmux) ;
+	pcntscale_t * psS = &sS ;
+	if (psS->Den == 0) {
+		*pu64Int = Val ;
+		*pu32Frac = 0 ;
+		return -1 ;
+	}
+	u64_t Prod = (u64_t) Val * psS->Num ;				// exact, 32 x 32 bits
+	u64_t Rem = Prod % psS->Den ;						// Rem * 10^9 still fits 64 bits
+	*pu64Int = Prod / psS->Den ;
+	*pu32Frac = (Rem * u32PCpow10[psS->Dec] + psS->Den / 2) / psS->Den ;
+	if (*pu32Frac == u32PCpow10[psS->Dec]) {			// rounded up into the integer part
+		++*pu64Int ;
+		*pu32Frac = 0 ;
+	}
+	return psS->Dec ;
+}
+
+/**
+ * Render a bucket or running count of a channel, signed for virtual channels & scaled if set
+ */
+static char * pcPulseCountValtoA(char * pC, int Ch, u32_t Val) {
+	bool bNeg ;
+	u64_t Int ;
+	u32_t Frac ;
+	int Dec = xPulseCountScaleSplit(Ch, Val, &bNeg, &Int, &Frac) ;
+	if (bNeg && (Int || Frac)) *pC++ = '-' ;
+	pC = pcPulseCountU64toA(pC, Int) ;
+	if (Dec > 0) {
+		*pC++ = '.' ;
+		pC = pcPulseCountPad(pC, Frac, Dec) + Dec ;
+	}
+	return pC ;
+}
+
+// ###################################### Export support ###########################################
+
+static void vPulseCountWrFlush(pcntwr_t * psWR) {
+	if (psWR->Len && psWR->iRV == erSUCCESS)
+		psWR->iRV = psWR->Sink(psWR->pvArg, psWR->Buf, psWR->Len) ;
+	psWR->Len = 0 ;
+}
+
+static void vPulseCountWrBytes(pcntwr_t * psWR, const void * pvSrc, size_t Size) {
+	const u8_t * pU8 = pvSrc ;
+	while (Size--) {
+		if (psWR->Len == sizeof(psWR->Buf))
+			vPulseCountWrFlush(psWR) ;
+		psWR->Buf[psWR->Len++] = *pU8++ ;
+	}
+}
+
+static void vPulseCountWrStr(pcntwr_t * psWR, const char * pcStr) {
+	vPulseCountWrBytes(psWR, pcStr, strlen(pcStr)) ;
+}
+
+static void vPulseCountWrU32(pcntwr_t * psWR, u32_t Val) {
+	char caBuf[10] ;
+	vPulseCountWrBytes(psWR, caBuf, pcPulseCountU32toA(caBuf, Val) - caBuf) ;
+}
+
+/**
+ * Write unsigned LEB128 varint, 7 bits per byte, LSB group first
+ */
+static void vPulseCountWrVarint(pcntwr_t * psWR, u32_t Val) {
+	u8_t Buf[5], Len = 0 ;
+	while (Val > 0x7F) {
+		Buf[Len++] = (Val & 0x7F) | 0x80 ;
+		Val >>= 7 ;
+	}
+	Buf[Len++] = Val ;
+	vPulseCountWrBytes(psWR, Buf, Len) ;
+}
+
+/**
+ * Write CBOR initial byte(s) for major type & argument using shortest encoding
+ */
+static void vPulseCountWrCBOR(pcntwr_t * psWR, u8_t Major, u64_t Arg) {
+	u8_t Buf[9], Len ;
+	Major <<= 5 ;
+	if (Arg < 24) {
+		Buf[0] = Major | Arg ;							Len = 1 ;
+	} else if (Arg <= 0xFF) {
+		Buf[0] = Major | 24 ;	Buf[1] = Arg ;			Len = 2 ;
+	} else if (Arg <= 0xFFFF) {
+		Buf[0] = Major | 25 ;	Buf[1] = Arg >> 8 ;		Buf[2] = Arg ;	Len = 3 ;
+	} else if (Arg <= 0xFFFFFFFF) {
+		Buf[0] = Major | 26 ;	Buf[1] = Arg >> 24 ;	Buf[2] = Arg >> 16 ;
+		Buf[3] = Arg >> 8 ;		Buf[4] = Arg ;			Len = 5 ;
+	} else {
+		Buf[0] = Major | 27 ;	Len = 9 ;
+		for (int i = 8; i > 0; --i, Arg >>= 8) Buf[i] = Arg ;
+	}
+	vPulseCountWrBytes(psWR, Buf, Len) ;
+}
+
+static void vPulseCountWrKey(pcntwr_t * psWR, int Fmt, const char * pcKey) {
+	if (Fmt == pcntFMT_CBOR) {
+		vPulseCountWrCBOR(psWR, 3, strlen(pcKey)) ;		// text string
+		vPulseCountWrStr(psWR, pcKey) ;
+	} else {
+		vPulseCountWrBytes(psWR, "\"", 1) ;
+		vPulseCountWrStr(psWR, pcKey) ;
+		vPulseCountWrBytes(psWR, "\":", 2) ;
+	}
+}
+
+/**
+ * Write a bucket or running count of a channel, as pcPulseCountValtoA(). CBOR values are
+ * integers, scaled values with decimals a decimal fraction (tag 4) [-Dec, mantissa]
+ */
+static void vPulseCountWrValue(pcntwr_t * psWR, int Fmt, int Ch, u32_t Val) {
+	if (Fmt == pcntFMT_JSON) {
+		char caBuf[pcntVALUE_SIZE] ;
+		vPulseCountWrBytes(psWR, caBuf, pcPulseCountValtoA(caBuf, Ch, Val) - caBuf) ;
+		return ;
+	}
+	bool bNeg ;
+	u64_t Int ;
+	u32_t Frac ;
+	int Dec = xPulseCountScaleSplit(Ch, Val, &bNeg, &Int, &Frac) ;
+	if (Dec > 0) {
+		vPulseCountWrCBOR(psWR, 6, 4) ;					// tag, decimal fraction
+		vPulseCountWrCBOR(psWR, 4, 2) ;
+		vPulseCountWrCBOR(psWR, 1, Dec - 1) ;			// exponent -Dec
+		Int = Int * u32PCpow10[Dec] + Frac ;
+	}
+	bNeg = bNeg && Int ;
+	vPulseCountWrCBOR(psWR, bNeg, bNeg ? Int - 1 : Int) ;	// unsigned or negative (-1 - n) integer
+}
+
+/**
+ * Export a single tier as {"td":N,"b":[...]}
+ */
+static void vPulseCountWrTier(pcntwr_t * psWR, int Fmt, int Ch, int Tier) {
+	int Depth = sPCtier[Tier].Depth ;
+	vPulseCountWrKey(psWR, Fmt, pcPCkey[Tier]) ;
+	if (Fmt == pcntFMT_CBOR) vPulseCountWrCBOR(psWR, 5, 2) ;	else vPulseCountWrBytes(psWR, "{", 1) ;
+	vPulseCountWrKey(psWR, Fmt, "td") ;
+	vPulseCountWrValue(psWR, Fmt, Ch, xPulseCountVal(Ch, Tier, -1)) ;
+	if (Fmt == pcntFMT_JSON) vPulseCountWrBytes(psWR, ",", 1) ;
+	vPulseCountWrKey(psWR, Fmt, "b") ;
+	if (Fmt == pcntFMT_CBOR) vPulseCountWrCBOR(psWR, 4, Depth) ;	else vPulseCountWrBytes(psWR, "[", 1) ;
+	for (int j = 0; j < Depth; ++j) {
+		if (Fmt == pcntFMT_JSON && j) vPulseCountWrBytes(psWR, ",", 1) ;
+		vPulseCountWrValue(psWR, Fmt, Ch, xPulseCountVal(Ch, Tier, j)) ;
+	}
+	if (Fmt == pcntFMT_JSON) vPulseCountWrBytes(psWR, "]}", 2) ;
+}
+
 // ########################################### Public functions ####################################
 
-int xPulseCountInit(int NumCh) {
-	if (OUTSIDE(0, NumCh, 255)) return erFAILURE;
+enum { pcntREAD_QUERY, pcntREAD_COLD, pcntREAD_HIST, pcntREAD_QTR, pcntREAD_TARIFF } ;
+
+#if (pcntVIRT_MAX > 0)
+typedef struct { int Read, iRV ; u32_t A, B, C ; } pcntread_t ;
+
+static u32_t xPulseCountReadTerm(int Ch, void * pvArg) {
+	pcntread_t * psR = pvArg ;
+	u32_t Val = 0 ;
+	int iRV ;
+	switch (psR->Read) {
+	case pcntREAD_QUERY:	iRV = xPulseCountQuery(Ch, psR->A, psR->B, &Val) ;				break ;
+	case pcntREAD_COLD:		iRV = xPulseCountCold(Ch, psR->A, psR->B, psR->C, &Val) ;		break ;
+	case pcntREAD_HIST:		iRV = xPulseCountHistory(Ch, psR->A, psR->B, &Val) ;			break ;
+	case pcntREAD_QTR:		iRV = xPulseCountQtr(Ch, psR->A, &Val) ;						break ;
+	default:				iRV = xPulseCountTariff(Ch, psR->A, psR->B, &Val) ;			break ;
+	}
+	if (iRV < psR->iRV && psR->iRV >= erSUCCESS) psR->iRV = iRV ;	// keep first failure
+	return Val ;
+}
+#endif
+
+/**
+ * Weighted sum of a reader over the terms of a virtual channel, fails if any term fails,
+ * for xPulseCountQuery() the result is pcntQUERY_EXACT only if exact for every term
+ */
+static int xPulseCountVirtRead(int Idx, int Read, u32_t A, u32_t B, u32_t C, u32_t * pu32) {
+	#if (pcntVIRT_MAX > 0)
+	if (OUTSIDE(0, Idx, pcntCH_ALL-1) || pu32 == NULL) return erFAILURE ;
+	pcntread_t sR = { .Read = Read, .iRV = pcntQUERY_EXACT, .A = A, .B = B, .C = C } ;
+	u32_t Sum = xPulseCountVirtSum(Idx, xPulseCountReadTerm, &sR) ;
+	if (sR.iRV < erSUCCESS) return sR.iRV ;
+	*pu32 = Sum ;
+	return (Read == pcntREAD_QUERY) ? sR.iRV : erSUCCESS ;
+	#else
+	(void) Idx ; (void) Read ; (void) A ; (void) B ; (void) C ; (void) pu32 ;
+	return erFAILURE ;
+	#endif
+}
+
+#if (pcntTARIFFS > 0)
+/**
+ * Tariff applicable to the minute starting at psTM, that of the latest schedule entry
+ * for the day of week starting at or before the minute, 0 if none
+ */
+static u8_t xPulseCountTariffAt(struct tm * psTM) {
+	int Now = psTM->tm_hour * MINUTES_IN_HOUR + psTM->tm_min ;
+	int Best = -1 ;
+	u8_t Tariff = 0 ;
+	portENTER_CRITICAL_SAFE(&sPCmux) ;					// schedule & length as one
+	const pcnttou_t * psTou = psPCtou ;
+	int Num = pcntTouNum ;
+	portEXIT_CRITICAL_SAFE(&sPCmux) ;
+	for (int i = 0; i < Num; ++i) {
+		const pcnttou_t * psT = &psTou[i] ;
+		if ((psT->Days & (1 << psTM->tm_wday)) == 0 || psT->Start > Now || psT->Start < Best) continue ;
+		Best = psT->Start ;
+		Tariff = psT->Tariff ;
+	}
+	return Tariff ;
+}
+#endif
+
+/**
+ * Worst case bytes for a channel with features Feat, dense history being the largest form
+ */
+static size_t xPulseCountCost(int Feat) {
+	size_t Size = sizeof(pulsecnt_t) + sizeof(pcntxtra_t) + xPulseCountDenseSize(Feat) ;
+	if (Feat & pcntFEAT_STAT) Size += sizeof(pcntstatset_t) ;
+	#if (pcntOPT_LEAK > 0)
+	if (Feat & pcntFEAT_LEAK) Size += sizeof(pcntleak_t) ;
+	#endif
+	#if (pcntTARIFFS > 0)
+	if (Feat & pcntFEAT_TOU) Size += sizeof(pcnttousum_t) ;
+	#endif
+	#if (pcntHIST_MONTHS > 0 || pcntHIST_YEARS > 0)
+	if (Feat & pcntFEAT_HIST) Size += sizeof(pcnthist_t) ;
+	#endif
+	#if (pcntQTR_DAYS > 0)
+	if (Feat & pcntFEAT_QTR) Size += pcntQTR_SLOTS * sizeof(u16_t) ;
+	#endif
+	#if (pcntCOLD_SIZE > 0)
+	if (Feat & pcntFEAT_COLD) Size += sizeof(pcntcold_t) ;
+	#endif
+	#if (pcntOPT_QUERY > 0)
+	if (Feat & pcntFEAT_QUERY) Size += pcntSLOTS * sizeof(u32_t) ;
+	#endif
+	return Size ;
+}
+
+static void * pvPulseCountAlloc(size_t Size) {
+	void * pvMem = pvRtosMalloc(Size) ;
+	if (pvMem) memset(pvMem, 0, Size) ;
+	return pvMem ;
+}
+
+/**
+ * Allocate all channel memory, on any failure release whatever was allocated
+ */
+static int xPulseCountAlloc(int NumCh, const pcnthint_t * psHint) {
+	psPCdata = pvPulseCountAlloc(NumCh * sizeof(pulsecnt_t)) ;
+	psPCxtra = pvPulseCountAlloc(NumCh * sizeof(pcntxtra_t)) ;
+	if (psPCdata == NULL || psPCxtra == NULL) {
+		if (psPCdata) vRtosFree(psPCdata) ;
+		if (psPCxtra) vRtosFree(psPCxtra) ;
+		psPCdata = NULL ;
+		psPCxtra = NULL ;
+		return erFAILURE ;
+	}
 	pcntNumCh = NumCh ;
-	psPCdata = pvRtosMalloc(NumCh * sizeof(pulsecnt_t)) ;
+	bool bFail = 0 ;
+	for (int i = 0; i < NumCh && bFail == 0; ++i) {
+		pcntxtra_t * psPX = &psPCxtra[i] ;
+		psPX->Feat = psHint ? psHint[i].Have : pcntFEAT_INIT ;
+		if (psPX->Feat & pcntFEAT_STAT) {
+			psPX->psStat = pvPulseCountAlloc(sizeof(pcntstatset_t)) ;
+			bFail |= (psPX->psStat == NULL) ;
+		}
+		#if (pcntOPT_LEAK > 0)
+		if (psPX->Feat & pcntFEAT_LEAK) {
+			psPX->psLeak = pvPulseCountAlloc(sizeof(pcntleak_t)) ;
+			bFail |= (psPX->psLeak == NULL) ;
+		}
+		#endif
+		#if (pcntTARIFFS > 0)
+		if (psPX->Feat & pcntFEAT_TOU) {
+			psPX->psTou = pvPulseCountAlloc(sizeof(pcnttousum_t)) ;
+			bFail |= (psPX->psTou == NULL) ;
+		}
+		#endif
+		#if (pcntHIST_MONTHS > 0 || pcntHIST_YEARS > 0)
+		if (psPX->Feat & pcntFEAT_HIST) {
+			psPX->psHist = pvPulseCountAlloc(sizeof(pcnthist_t)) ;
+			bFail |= (psPX->psHist == NULL) ;
+		}
+		#endif
+		#if (pcntQTR_DAYS > 0)
+		if (psPX->Feat & pcntFEAT_QTR) {
+			psPX->pu16Qtr = pvPulseCountAlloc(pcntQTR_SLOTS * sizeof(u16_t)) ;
+			bFail |= (psPX->pu16Qtr == NULL) ;
+		}
+		#endif
+		#if (pcntCOLD_SIZE > 0)
+		if (psPX->Feat & pcntFEAT_COLD) {
+			psPX->psCold = pvPulseCountAlloc(sizeof(pcntcold_t)) ;
+			bFail |= (psPX->psCold == NULL) ;
+		}
+		#endif
+		#if (pcntOPT_QUERY > 0)
+		if (psPX->Feat & pcntFEAT_QUERY) {
+			psPX->pu32Cum = pvPulseCountAlloc(pcntSLOTS * sizeof(u32_t)) ;
+			bFail |= (psPX->pu32Cum == NULL) ;
+		}
+		#endif
+	}
+	if (bFail) {
+		vPulseCountDeinit() ;
+		return erFAILURE ;
+	}
 	return erSUCCESS;
 }
 
+int xPulseCountInit(int NumCh) {
+	if (OUTSIDE(0, NumCh, 255) || psPCdata) return erFAILURE;
+	return xPulseCountAlloc(NumCh, NULL) ;
+}
+
+int xPulseCountInitBudget(int NumCh, size_t Budget, pcnthint_t * psHint) {
+	if (OUTSIDE(0, NumCh, 255) || psHint == NULL || psPCdata) return erFAILURE;
+	static const u8_t DropOrder[] = {
+		pcntFEAT_QUERY, pcntFEAT_COLD, pcntFEAT_STAT, pcntFEAT_LEAK, pcntFEAT_HIST, pcntFEAT_QTR, pcntFEAT_TOU, pcntFEAT_MIN
+	} ;
+	size_t Total = 0 ;
+	for (int i = 0; i < NumCh; ++i) {					// start with maximum resolution everywhere
+		psHint[i].Have = pcntFEAT_ALL ;
+		Total += xPulseCountCost(pcntFEAT_ALL) ;
+	}
+	while (Total > Budget) {
+		/* Strip the lowest priority channel (highest index on ties) one feature at a time,
+		 * least valuable first, never touching features the channel needs */
+		int Ch = -1 ;
+		for (int i = 0; i < NumCh; ++i)
+			if ((psHint[i].Have & ~psHint[i].Need) && (Ch < 0 || psHint[i].Priority <= psHint[Ch].Priority))
+				Ch = i ;
+		if (Ch < 0) return erFAILURE ;					// cannot fit even at minimum resolution
+		for (int j = 0; j < (int) sizeof(DropOrder); ++j) {
+			if ((psHint[Ch].Have & ~psHint[Ch].Need & DropOrder[j]) == 0) continue ;
+			Total -= xPulseCountCost(psHint[Ch].Have) ;
+			psHint[Ch].Have &= ~DropOrder[j] ;
+			Total += xPulseCountCost(psHint[Ch].Have) ;
+			break ;
+		}
+	}
+	for (int i = 0; i < NumCh; ++i)
+		psHint[i].Bytes = xPulseCountCost(psHint[i].Have) ;
+	return xPulseCountAlloc(NumCh, psHint) ;
+}
+
+void vPulseCountDeinit(void) {
+	if (psPCdata == NULL) return ;
+	for (int i = 0; i < pcntNumCh; ++i) {
+		pcntxtra_t * psPX = &psPCxtra[i] ;
+		if (psPX->psRate) vRtosFree(psPX->psRate) ;
+		if (psPX->psDense) vRtosFree(psPX->psDense) ;
+		if (psPX->psSparse) vRtosFree(psPX->psSparse) ;
+		if (psPX->psStat) vRtosFree(psPX->psStat) ;
+		#if (pcntOPT_LEAK > 0)
+		if (psPX->psLeak) vRtosFree(psPX->psLeak) ;
+		#endif
+		#if (pcntTARIFFS > 0)
+		if (psPX->psTou) vRtosFree(psPX->psTou) ;
+		#endif
+		#if (pcntHIST_MONTHS > 0 || pcntHIST_YEARS > 0)
+		if (psPX->psHist) vRtosFree(psPX->psHist) ;
+		#endif
+		#if (pcntQTR_DAYS > 0)
+		if (psPX->pu16Qtr) vRtosFree(psPX->pu16Qtr) ;
+		#endif
+		#if (pcntCOLD_SIZE > 0)
+		if (psPX->psCold) vRtosFree(psPX->psCold) ;
+		#endif
+		#if (pcntOPT_QUERY > 0)
+		if (psPX->pu32Cum) vRtosFree(psPX->pu32Cum) ;
+		#endif
+	}
+	vPulseCountReclaim(1) ;
+	while (psPCsec) {
+		pcntsec_t * psS = psPCsec ;
+		psPCsec = psS->psNext ;
+		vRtosFree(psS) ;
+	}
+	while (psPCalarm) {
+		pcntalarm_t * psA = psPCalarm ;
+		psPCalarm = psA->psNext ;
+		vRtosFree(psA) ;
+	}
+	bPCalarm = 0 ;
+	#if (pcntHIST_MONTHS > 0 || pcntHIST_YEARS > 0)
+	u32PChistMon = u32PChistYear = 0 ;
+	#endif
+	#if (pcntQTR_DAYS > 0)
+	memset(u32PCqseq, 0, sizeof(u32PCqseq)) ;
+	pcntQtrLast = -1 ;
+	#endif
+	#if (pcntOPT_QUERY > 0)
+	memset(u32PCtime, 0, sizeof(u32PCtime)) ;
+	#endif
+	memset(u32PCseq, 0, sizeof(u32PCseq)) ;
+	vRtosFree(psPCxtra) ;
+	vRtosFree(psPCdata) ;
+	psPCxtra = NULL ;
+	psPCdata = NULL ;
+	pcntNumCh = 0 ;
+	#if (pcntVIRT_MAX > 0)
+	pcntVirtNum = 0 ;
+	#endif
+	pcntSeq = pcntEpoch = 0 ;
+	#if (pcntTARIFFS > 0)
+	pcntTouNow = 0 ;
+	#endif
+	bPCback = bPCcatch = 0 ;
+	memset(&sPChealth, 0, sizeof(sPChealth)) ;
+}
+
 /**
- * Update all fields in the basic counter structure.
- * @param 	psTM	Current time structure
- * @return	-1 = repeat call this minute, 0 = normal update, 1 = month end update
+ * Close sub-minute slot Slot with the pulses since the previous one closed, slots skipped
+ * by missed ticks are zeroed as their pulses are counted in this one
  */
-int	xPulseCountUpdate(struct tm * psTM) {
-	if (psTM->tm_sec != 0 || psTM->tm_min == LastMin)
-		return -1; 										// ??:??:00, once only..
-	LastMin = psTM->tm_min ;
+static void vPulseCountSecClose(pcntsec_t * psS, int Slot, u8_t MinTD) {
+	int Num = SECONDS_IN_MINUTE / psS->Period ;
+	for (int i = (psS->Last + 1) % Num; i != Slot; i = (i + 1) % Num)
+		psS->Slot[i] = 0 ;
+	psS->Slot[Slot] = MinTD - psS->Base ;
+	psS->Last = Slot ;
+	psS->Base = MinTD ;
+}
+
+/**
+ * Forget the rate samples once the newest is older than the timeout. Called from every
+ * rollover as well as xPulseCountRate() so that, with the timeout limited to an hour, the
+ * u32_t uSec stamps are never compared across a wrap (~71.6 minutes)
+ */
+static void vPulseCountRateExpire(pcntrate_t * psR, u32_t YTD, u32_t NowUs) {
+	if (YTD != psR->Base && (NowUs - psR->Stamp[YTD & (pcntRATE_SAMPLES - 1)]) >= psR->Timeout)
+		psR->Base = YTD ;
+}
+
+/**
+ * Roll over all channels at the minute boundary in psTM, one minute after the previous one.
+ * @return	0 = normal update, 1 = month end update
+ */
+static int xPulseCountStep(struct tm * psTM) {
+	pcntTIME_START(Start) ;
+	++pcntSeq ;
+	vPulseCountReclaim(0) ;
+	u32_t Epoch = xPulseCountEpoch(psTM->tm_year, psTM->tm_mon, psTM->tm_mday, psTM->tm_hour, psTM->tm_min) ;
+	#if (pcntOPT_BENCH > 0)
+	if (Epoch <= pcntEpoch) ++u32PCrewrite ;			// completed buckets written again
+	#endif
+	pcntEpoch = Epoch ;
+	#if (pcntQTR_DAYS > 0)
+	/* Quarter hour slots are those of the interval just ended, not of the boundary,
+	 * so that settlement data is labelled with the interval it covers */
+	int QtrSlot = -1 ;
+	if ((psTM->tm_min % pcntQTR_MINUTES) == 0) {
+		u32_t Start = pcntEpoch - pcntQTR_MINUTES * 60 ;
+		QtrSlot = ((Start / 86400) % pcntQTR_DAYS) * pcntQTR_PER_DAY + (Start % 86400) / (pcntQTR_MINUTES * 60) ;
+		u32PCqseq[QtrSlot] = pcntSeq ;
+		pcntQtrLast = QtrSlot ;
+	}
+	#endif
 	int iRV = 0 ;										// default for "NORMAL" update
+	int DIM = 0 ;										// days in month just completed
+	if (psTM->tm_mday == 1 && psTM->tm_hour == 0 && psTM->tm_min == 0) {
+		struct tm sTM = { .tm_year = psTM->tm_year, .tm_mon = psTM->tm_mon - 1, .tm_mday = 1 } ;
+		if (sTM.tm_mon < 0) { sTM.tm_mon = 11 ; --sTM.tm_year ; }
+		DIM = xTimeCalcDaysInMonth(&sTM) ;
+		#if (pcntHIST_MONTHS > 0 || pcntHIST_YEARS > 0)
+		++u32PChistMon ;								// all channels append at same slot
+		if (psTM->tm_mon == 0) ++u32PChistYear ;
+		#endif
+	}
+	for (pcntsec_t * psS = psPCsec; psS; psS = psS->psNext) {	// fold seconds tier into minute
+		vPulseCountSecClose(psS, SECONDS_IN_MINUTE / psS->Period - 1, psPCdata[psS->Ch].MinTD) ;
+		psS->Base = 0 ;
+	}
+	#if (pcntOPT_LEAK > 0)
+	int PrevMin = (psTM->tm_min + MINUTES_IN_HOUR - 1) % MINUTES_IN_HOUR ;	// minute just completed
+	int PrevHour = psTM->tm_min ? psTM->tm_hour : (psTM->tm_hour + HOURS_IN_DAY - 1) % HOURS_IN_DAY ;
+	bool bNight = ((PrevHour - pcntNIGHT_START + HOURS_IN_DAY) % HOURS_IN_DAY) < pcntNIGHT_HOURS ;
+	bool bNightEnd = psTM->tm_min == 0 && psTM->tm_hour == (pcntNIGHT_START + pcntNIGHT_HOURS) % HOURS_IN_DAY ;
+	#endif
+	u32_t NowUs = esp_timer_get_time() ;
 	for (int i = 0; i < pcntNumCh; ++i) {
 		pulsecnt_t * psPC = &psPCdata[i] ;
-		psPC->Min[psTM->tm_min]	= psPC->MinTD ;			// persist last minute
-		psPC->MinTD = 0 ;
+		if (psPCxtra[i].psRate) vPulseCountRateExpire(psPCxtra[i].psRate, psPC->YearTD, NowUs) ;
+		u32_t MinTD = xPulseCountTD(psPC, pcntTIER_MIN) ;
+		psPCxtra[i].Total += MinTD ;
+		#if (pcntOPT_LEAK > 0)
+		if (psPCxtra[i].psLeak)
+			vPulseCountFlow(psPCxtra[i].psLeak, MinTD > UINT8_MAX ? UINT8_MAX : MinTD, PrevMin, bNight, bNightEnd) ;
+		#endif
+		if (MinTD > psPCxtra[i].Peak) psPCxtra[i].Peak = MinTD > UINT8_MAX ? UINT8_MAX : MinTD ;
+		#if (pcntTARIFFS > 0)
+		/* Tariffs only switch on minute boundaries so the whole minute belongs to one,
+		 * folded here rather than counted per pulse */
+		pcnttousum_t * psT = psPCxtra[i].psTou ;
+		if (psT) {
+			psT->TouTD[pcntTouNow] += MinTD ;
+			if (DIM) {									// billing month completed
+				memcpy(psT->TouLast, psT->TouTD, sizeof(psT->TouLast)) ;
+				memset(psT->TouTD, 0, sizeof(psT->TouTD)) ;
+			}
+		}
+		#endif
+		#if (pcntQTR_DAYS > 0)
+		psPCxtra[i].QtrTD += MinTD ;					// minute tier feeds quarter hours
+		if (QtrSlot >= 0) {
+			if (psPCxtra[i].pu16Qtr)
+				psPCxtra[i].pu16Qtr[QtrSlot] = psPCxtra[i].QtrTD ;
+			psPCxtra[i].QtrTD = 0 ;
+		}
+		#endif
+		vPulseCountRollover(psPC, pcntTIER_MIN, psTM->tm_min, 0) ;			// persist last minute
 
 		if (psTM->tm_min == 0) {						// 0 -> 59
-			psPC->Hour[psTM->tm_hour] = psPC->HourTD ;	// persist last hour
-			psPC->HourTD = 0 ;
+			vPulseCountRollover(psPC, pcntTIER_HOUR, psTM->tm_hour, 0) ;		// persist last hour
 		} else if (psTM->tm_min == 59 &&
 					psTM->tm_hour == 23 &&
 					psTM->tm_mday == xTimeCalcDaysInMonth(psTM)) {
 			/* At this point we are at 23:59.00 of the last day in this calendar month
 			 * In order have averages correct ZERO remaining (not in month) array days */
-			for (int i = psTM->tm_mday; i < DAYS_IN_MONTH_MAX; psPC->Day[i] = 0, ++i) ;
+			for (int i = psTM->tm_mday; i < DAYS_IN_MONTH_MAX; ++i)
+				vPulseCountPersist(psPC, pcntTIER_DAY, i, 0) ;
 			iRV = 1 ; 									// special "MONTHEND" update
 		} else {
 			continue ;
@@ -101,61 +1392,1115 @@ int	xPulseCountUpdate(struct tm * psTM) {
 
 		if (psTM->tm_hour != 0)
 			continue;									// 0 -> 23
-		psPC->Day[psTM->tm_mday-1] = psPC->DayTD ;		// persist last day (make 0 relative)
-		psPC->DayTD = 0 ;
+		vPulseCountRollover(psPC, pcntTIER_DAY, psTM->tm_mday-1, 0) ;		// persist last day (make 0 relative)
+		vPulseCountSparseCheck(psPC) ;
 
 		if (psTM->tm_mday != 1)
 			continue;									// 1 -> 31
-		psPC->Mon[psTM->tm_mon] = psPC->MonTD ;			// persist last month
-		psPC->MonTD = 0 ;
+		vPulseCountRollover(psPC, pcntTIER_MON, psTM->tm_mon, DIM) ;		// persist last month
 
 		if (psTM->tm_mon != 0)
 			continue;									// 0 -> 11
-		psPC->Year = psPC->YearTD ;						// persist last year
-		psPC->YearTD = 0 ;
+		vPulseCountRollover(psPC, pcntTIER_YEAR, 0, 0) ;					// persist last year
+	}
+	#if (pcntTARIFFS > 0)
+	pcntTouNow = xPulseCountTariffAt(psTM) ;
+	#endif
+	if (psPCalarm) {									// re-arm alarms of tiers just cleared
+		int Tiers = pcntMASK(pcntTIER_MIN) ;
+		if (psTM->tm_min == 0) {
+			Tiers |= pcntMASK(pcntTIER_HOUR) ;
+			if (psTM->tm_hour == 0) {
+				Tiers |= pcntMASK(pcntTIER_DAY) ;
+				if (psTM->tm_mday == 1) {
+					Tiers |= pcntMASK(pcntTIER_MON) ;
+					if (psTM->tm_mon == 0) Tiers |= pcntMASK(pcntTIER_YEAR) ;
+				}
+			}
+		}
+		for (pcntalarm_t * psA = psPCalarm; psA; psA = psA->psNext)
+			if (Tiers & pcntMASK(psA->Tier)) psA->Fired = 0 ;
+		vPulseCountAlarmArm(-1) ;
 	}
+	#if (debugTIMING > 0)
+	int Phase = iRV ? pcntPHASE_MEND :
+				psTM->tm_min ? pcntPHASE_MIN :
+				psTM->tm_hour ? pcntPHASE_HOUR :
+				(psTM->tm_mday != 1) ? pcntPHASE_DAY :
+				psTM->tm_mon ? pcntPHASE_MON : pcntPHASE_YEAR ;
+	pcntTIME_STOP(Phase, Start) ;
+	#endif
+	return iRV ;
+}
+
+/**
+ * While a step back is absorbed the minute in progress spans more than a minute, move its
+ * pulses out of MinTD before it wraps, they are added back by xPulseCountTD()
+ */
+static void vPulseCountAbsorb(void) {
+	for (int i = 0; i < pcntNumCh; ++i) {
+		u8_t Val = psPCdata[i].MinTD ;
+		if (Val == 0) continue ;
+		__atomic_fetch_sub(&psPCdata[i].MinTD, Val, __ATOMIC_RELAXED) ;	// ISR may have added since
+		psPCxtra[i].BackTD += Val ;
+		for (pcntsec_t * psS = psPCsec; psS; psS = psS->psNext)	// keep slot differences
+			if (psS->Ch == i) psS->Base -= Val ;
+	}
+}
+
+/**
+ * Update all fields in the basic counter structure.
+ * Boundaries are tracked by time rather than by minute so that clock corrections (SNTP, DST)
+ * are handled: a minute first seen after :00 still rolls over, a backward step is absorbed
+ * until the clock passes the last boundary again and a forward step rolls through the missed
+ * boundaries, pcntSTEP_BATCH per call, pulses counted meanwhile going to the first of them.
+ * Forward steps beyond pcntSTEP_MAX minutes resync at once, missed boundaries are not rolled.
+ * A boundary is never rolled twice, so completed buckets are not overwritten however far back
+ * the clock steps, the minute in progress then collects all pulses until it is passed again.
+ * @param 	psTM	Current time structure
+ * @return	-1 = no boundary passed, 0 = normal update, 1 = month end update
+ */
+int	xPulseCountUpdate(struct tm * psTM) {
+	if (pcntEpoch == 0) {								// first boundary, wait for ??:??:00
+		if (psTM->tm_sec != 0) return -1 ;
+		return xPulseCountStep(psTM) ;
+	}
+	u32_t Now = xPulseCountEpoch(psTM->tm_year, psTM->tm_mon, psTM->tm_mday, psTM->tm_hour, psTM->tm_min) ;
+	if (Now <= pcntEpoch) {
+		if (Now < pcntEpoch) {							// stepped back, completed buckets kept
+			if (bPCback == 0) ++sPChealth.StepBack ;
+			bPCback = 1 ;
+		} else if (psTM->tm_sec == 0 && bPCback == 0) {
+			++sPChealth.Repeat ;
+		}
+		if (bPCback) vPulseCountAbsorb() ;
+		return -1;
+	}
+	bPCback = 0 ;
+	u32_t Gap = (Now - pcntEpoch) / 60 ;
+	if (Gap == 1) {
+		if (psTM->tm_sec != 0) ++sPChealth.Late ;		// missed ??:??:00 of this minute
+		return xPulseCountStep(psTM) ;
+	}
+	if (Gap > pcntSTEP_MAX) {							// beyond catching up, resync
+		++sPChealth.Resync ;
+		sPChealth.Skipped += Gap - 1 ;
+		bPCcatch = 0 ;
+		return xPulseCountStep(psTM) ;
+	}
+	if (bPCcatch == 0) ++sPChealth.StepFwd ;
+	int iRV = 0 ;
+	struct tm sTM ;
+	for (int i = 0; i < pcntSTEP_BATCH && pcntEpoch < Now; ++i) {
+		u32_t Next = pcntEpoch + 60 ;
+		if (Next < Now) ++sPChealth.Skipped ;			// boundary rolled late
+		int Res = xPulseCountStep(xTimeGMTime(Next, &sTM, 0)) ;
+		if (Res > iRV) iRV = Res ;
+	}
+	bPCcatch = (pcntEpoch < Now) ;						// remainder on following calls
 	return iRV ;
 }
 
 int	xPulseCountIncrement(int Idx) {
-	if (OUTSIDE(0, Idx, pcntNumCh)) return erFAILURE;
+	if (OUTSIDE(0, Idx, pcntNumCh-1)) {
+		++sPChealth.Rejected ;
+		return erFAILURE;
+	}
+	pcntTIME_START(Start) ;
 	pulsecnt_t * psPC = &psPCdata[Idx] ;
-	psPC->MinTD++ ;
-	IF_PL(psPC->MinTD == 0, "Wrapped, Pulse rate too high\r\n") ;
-	psPC->HourTD++ ;
-	psPC->DayTD++ ;
-	psPC->MonTD++ ;
-	psPC->YearTD++ ;
+	pcntxtra_t * psPX = &psPCxtra[Idx] ;
+	if (++psPC->MinTD == 0) {
+		++psPX->Ovf[pcntTIER_MIN] ;
+		IF_PL(1, "Wrapped, Pulse rate too high\r\n") ;
+	}
+	if (++psPC->HourTD == 0) ++psPX->Ovf[pcntTIER_HOUR] ;
+	if (++psPC->DayTD == 0) ++psPX->Ovf[pcntTIER_DAY] ;
+	if (++psPC->MonTD == 0) ++psPX->Ovf[pcntTIER_MON] ;
+	u32_t YTD = ++psPC->YearTD ;
+	if (YTD == 0) ++psPX->Ovf[pcntTIER_YEAR] ;
+	if (__atomic_load_n(&psPX->Armed, __ATOMIC_ACQUIRE) &&	// single compare unless armed, callback from task
+		YTD == __atomic_load_n(&psPX->TripAt, __ATOMIC_RELAXED)) {
+		psPX->AlarmPend = 1 ;
+		bPCalarm = 1 ;
+	}
+	pcntrate_t * psR = psPX->psRate ;
+	if (psR)
+		psR->Stamp[YTD & (pcntRATE_SAMPLES - 1)] = esp_timer_get_time() ;
+	pcntTIME_STOP(pcntTIME_INC, Start) ;
 	return erSUCCESS;
 }
 
+int xPulseCountSecEnable(int Idx, int Period) {
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || OUTSIDE(0, Period, SECONDS_IN_MINUTE) ||
+		(Period && (SECONDS_IN_MINUTE % Period)))
+		return erFAILURE ;
+	pcntsec_t ** ppsS = &psPCsec ;
+	while (*ppsS && (*ppsS)->Ch != Idx) ppsS = &(*ppsS)->psNext ;
+	if (*ppsS) {										// already enabled, unlink & release
+		pcntsec_t * psS = *ppsS ;
+		*ppsS = psS->psNext ;
+		vRtosFree(psS) ;
+	}
+	if (Period == 0) return erSUCCESS ;
+	size_t Size = sizeof(pcntsec_t) + SECONDS_IN_MINUTE / Period ;
+	pcntsec_t * psS = pvRtosMalloc(Size) ;
+	if (psS == NULL) return erFAILURE ;
+	memset(psS, 0, Size) ;
+	psS->Ch = Idx ;
+	psS->Period = Period ;
+	psS->Last = SECONDS_IN_MINUTE / Period - 1 ;		// none closed this minute
+	psS->Base = psPCdata[Idx].MinTD ;
+	psS->psNext = psPCsec ;
+	psPCsec = psS ;
+	return erSUCCESS ;
+}
+
+void vPulseCountSecTick(struct tm * psTM) {
+	if (psTM->tm_sec == 0) return ;						// last slot closed by xPulseCountUpdate()
+	for (pcntsec_t * psS = psPCsec; psS; psS = psS->psNext) {
+		if (psTM->tm_sec % psS->Period) continue ;
+		int Slot = (psTM->tm_sec / psS->Period) - 1 ;
+		if (Slot <= psS->Last && psS->Last != SECONDS_IN_MINUTE / psS->Period - 1)
+			continue ;									// repeated or earlier second, merge into next
+		vPulseCountSecClose(psS, Slot, psPCdata[psS->Ch].MinTD) ;
+	}
+}
+
+int xPulseCountSec(int Idx, int Ago, u32_t * pu32Count) {
+	pcntsec_t * psS = psPCsec ;
+	while (psS && psS->Ch != Idx) psS = psS->psNext ;
+	if (psS == NULL || pu32Count == NULL) return erFAILURE ;
+	int Num = SECONDS_IN_MINUTE / psS->Period ;
+	if (OUTSIDE(0, Ago, Num - 1)) return erFAILURE ;
+	*pu32Count = psS->Slot[(psS->Last + Num - Ago) % Num] ;
+	return erSUCCESS ;
+}
+
+int xPulseCountAlarmAdd(int Idx, int Tier, u32_t Limit, pcntalarmcb_t pfCB, void * pvArg) {
+	static const u32_t TDmax[pcntTIER_NUM] = { UINT8_MAX, UINT8_MAX, UINT16_MAX, UINT16_MAX, UINT32_MAX } ;
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || OUTSIDE(0, Tier, pcntTIER_NUM-1) || pfCB == NULL ||
+		OUTSIDE(1, Limit, TDmax[Tier]))					// unreachable by the tier TD counter
+		return erFAILURE ;
+	pcntalarm_t * psA = pvRtosMalloc(sizeof(pcntalarm_t)) ;
+	if (psA == NULL) return erFAILURE ;
+	memset(psA, 0, sizeof(pcntalarm_t)) ;
+	psA->pfCB = pfCB ;
+	psA->pvArg = pvArg ;
+	psA->Limit = Limit ;
+	psA->Ch = Idx ;
+	psA->Tier = Tier ;
+	psA->psNext = psPCalarm ;
+	psPCalarm = psA ;
+	vPulseCountAlarmArm(Idx) ;
+	return erSUCCESS ;
+}
+
+int xPulseCountAlarmDel(int Idx, int Tier, u32_t Limit) {
+	pcntalarm_t ** ppsA = &psPCalarm ;
+	while (*ppsA && ((*ppsA)->Ch != Idx || (*ppsA)->Tier != Tier || (*ppsA)->Limit != Limit))
+		ppsA = &(*ppsA)->psNext ;
+	if (*ppsA == NULL) return erFAILURE ;
+	pcntalarm_t * psA = *ppsA ;
+	*ppsA = psA->psNext ;
+	vRtosFree(psA) ;
+	vPulseCountAlarmArm(Idx) ;
+	return erSUCCESS ;
+}
+
+void vPulseCountAlarmService(void) {
+	if (bPCalarm == 0) return ;
+	bPCalarm = 0 ;
+	for (int i = 0; i < pcntNumCh; ++i) {
+		pcntxtra_t * psPX = &psPCxtra[i] ;
+		if (psPX->AlarmPend == 0) continue ;
+		psPX->AlarmPend = 0 ;
+		pcntalarm_t * psA = psPCalarm ;
+		while (psA) {
+			if (psA->Ch == i && psA->Fired == 0) {
+				u32_t TD = xPulseCountTD(&psPCdata[i], psA->Tier) ;
+				if (TD >= psA->Limit) {
+					psA->Fired = 1 ;
+					psA->pfCB(psA->pvArg, i, psA->Tier, TD) ;
+					psA = psPCalarm ;					// callback may have added or deleted alarms
+					continue ;
+				}
+			}
+			psA = psA->psNext ;
+		}
+		vPulseCountAlarmArm(i) ;						// trip point of the next limit
+	}
+}
+
+int xPulseCountRateEnable(int Idx, u32_t TimeoutMs) {
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || TimeoutMs > pcntRATE_TIMEOUT_MAX) return erFAILURE ;
+	pcntxtra_t * psPX = &psPCxtra[Idx] ;
+	if (TimeoutMs == 0) {
+		pcntrate_t * psR = psPX->psRate ;
+		psPX->psRate = NULL ;							// detach from ISR before release
+		if (psR) vRtosFree(psR) ;
+		return erSUCCESS ;
+	}
+	if (psPX->psRate == NULL) {
+		pcntrate_t * psR = pvRtosMalloc(sizeof(pcntrate_t)) ;
+		if (psR == NULL) return erFAILURE ;
+		memset(psR, 0, sizeof(pcntrate_t)) ;
+		psR->Base = psPCdata[Idx].YearTD ;
+		psPX->psRate = psR ;
+	}
+	psPX->psRate->Timeout = TimeoutMs * 1000 ;
+	return erSUCCESS ;
+}
+
+int xPulseCountRate(int Idx, u32_t * pu32Inst, u32_t * pu32Smooth) {
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || psPCxtra[Idx].psRate == NULL) return erFAILURE ;
+	pcntrate_t * psR = psPCxtra[Idx].psRate ;
+	u32_t YTD = psPCdata[Idx].YearTD ;
+	vPulseCountRateExpire(psR, YTD, esp_timer_get_time()) ;
+	u32_t Num = YTD - psR->Base ;
+	if (Num > pcntRATE_SAMPLES) Num = pcntRATE_SAMPLES ;
+	u32_t Inst = 0 ;
+	if (Num >= 2) {
+		u32_t Newest = psR->Stamp[YTD & (pcntRATE_SAMPLES - 1)] ;
+		u32_t Oldest = psR->Stamp[(YTD - Num + 1) & (pcntRATE_SAMPLES - 1)] ;
+		u32_t Span = Newest - Oldest ;
+		if (Span) Inst = ((u64_t) (Num - 1) * 1000000000ULL) / Span ;
+	}
+	psR->Smooth += ((i32_t) (Inst - psR->Smooth)) >> pcntRATE_EMA_SHIFT ;
+	if (pu32Inst) *pu32Inst = Inst ;
+	if (pu32Smooth) *pu32Smooth = psR->Smooth ;
+	return erSUCCESS ;
+}
+
+int xPulseCountHealth(int Idx, bool bClear, pcnthealth_t * psHealth) {
+	if (OUTSIDE(-1, Idx, pcntNumCh-1) || psHealth == NULL) return erFAILURE ;
+	*psHealth = sPChealth ;
+	if (Idx < 0) {
+		if (bClear) memset(&sPChealth, 0, sizeof(sPChealth)) ;
+		return erSUCCESS ;
+	}
+	pcntxtra_t * psPX = &psPCxtra[Idx] ;
+	memcpy(psHealth->Ovf, psPX->Ovf, sizeof(psPX->Ovf)) ;
+	psHealth->Peak = psPX->Peak ;
+	if (bClear) {
+		memset(psPX->Ovf, 0, sizeof(psPX->Ovf)) ;
+		psPX->Peak = 0 ;
+	}
+	return erSUCCESS ;
+}
+
+static u32_t xPulseCountRollTerm(int Ch, void * pvArg) { return psPCxtra[Ch].Roll[*(int *) pvArg] ; }
+
+u32_t xPulseCountWindow(int Idx, int Tier) {
+	if (OUTSIDE(0, Idx, pcntCH_ALL-1) || OUTSIDE(pcntTIER_MIN, Tier, pcntTIER_DAY)) return 0 ;
+	return (Idx < pcntNumCh) ? xPulseCountRollTerm(Idx, &Tier) : xPulseCountVirtSum(Idx, xPulseCountRollTerm, &Tier) ;
+}
+
+int xPulseCountStats(int Idx, int Tier, bool bLast, pcntstats_t * psStats) {
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || OUTSIDE(pcntTIER_MIN, Tier, pcntTIER_MON) || psStats == NULL ||
+		psPCxtra[Idx].psStat == NULL)
+		return erFAILURE ;
+	pcntstatset_t * psSS = psPCxtra[Idx].psStat ;
+	pcntstat_t * psS = bLast ? &psSS->sLast[Tier] : &psSS->sStat[Tier] ;
+	int Div = bLast ? psS->Div : psS->Cnt ;
+	*psStats = (pcntstats_t) {
+		.Min = psS->Min, .Max = psS->Max, .Mean = Div ? psS->Sum / Div : 0,
+		.MinIdx = psS->MinIdx, .MaxIdx = psS->MaxIdx, .Count = psS->Cnt,
+	} ;
+	return erSUCCESS ;
+}
+
+#if (pcntOPT_QUERY > 0)
+/**
+ * Cumulative count at time T, from the finest tier still holding the boundary at or below T
+ * @return	pcntQUERY_EXACT if T is a retained boundary (or T1 at/after the last rollover)
+ */
+static int xPulseCountCumAt(int Idx, u32_t T, bool bEnd, u32_t * pu32Cum) {
+	pcntxtra_t * psPX = &psPCxtra[Idx] ;
+	if (T >= pcntEpoch) {								// at or after last rollover
+		*pu32Cum = psPX->Total ;
+		if (T == pcntEpoch) return pcntQUERY_EXACT ;
+		if (bEnd) *pu32Cum += xPulseCountTD(&psPCdata[Idx], pcntTIER_MIN) ;	// up to now, include running minute
+		return pcntQUERY_PARTIAL ;
+	}
+	struct tm sTM ;
+	xTimeGMTime(T, &sTM, 0) ;
+	u32_t Bound[pcntTIER_NUM] = {
+		[pcntTIER_MIN]	= T - (T % 60),
+		[pcntTIER_HOUR]	= T - (T % 3600),
+		[pcntTIER_DAY]	= T - (T % 86400),
+		[pcntTIER_MON]	= xPulseCountEpoch(sTM.tm_year, sTM.tm_mon, 1, 0, 0),
+		[pcntTIER_YEAR]	= xPulseCountEpoch(sTM.tm_year, 0, 1, 0, 0),
+	} ;
+	int Slot[pcntTIER_NUM] = {
+		[pcntTIER_MIN]	= sTM.tm_min,
+		[pcntTIER_HOUR]	= sTM.tm_hour,
+		[pcntTIER_DAY]	= sTM.tm_mday - 1,
+		[pcntTIER_MON]	= sTM.tm_mon,
+		[pcntTIER_YEAR]	= 0,
+	} ;
+	for (int t = 0; t < pcntTIER_NUM; ++t) {
+		if (t == pcntTIER_MIN && (psPX->Feat & pcntFEAT_MIN) == 0)
+			continue ;									// slot times are those of other channels
+		int S = sPCtier[t].Base + Slot[t] ;
+		if (u32PCtime[S] != Bound[t] || u32PCseq[S] == 0)
+			continue ;									// not retained at this resolution
+		*pu32Cum = psPX->pu32Cum[S] ;
+		return (Bound[t] == T) ? pcntQUERY_EXACT : pcntQUERY_PARTIAL ;
+	}
+	*pu32Cum = 0 ;										// before all retained history
+	return pcntQUERY_PARTIAL ;
+}
+#endif
+
+int xPulseCountQuery(int Idx, u32_t T0, u32_t T1, u32_t * pu32Sum) {
+	if (Idx >= pcntNumCh) return xPulseCountVirtRead(Idx, pcntREAD_QUERY, T0, T1, 0, pu32Sum) ;
+	#if (pcntOPT_QUERY > 0)
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || T0 > T1 || pu32Sum == NULL || psPCxtra[Idx].pu32Cum == NULL)
+		return erFAILURE ;
+	u32_t Cum0, Cum1 ;
+	int iRV0 = xPulseCountCumAt(Idx, T0, 0, &Cum0) ;
+	int iRV1 = xPulseCountCumAt(Idx, T1, 1, &Cum1) ;
+	*pu32Sum = Cum1 - Cum0 ;
+	return (iRV0 == pcntQUERY_EXACT && iRV1 == pcntQUERY_EXACT) ? pcntQUERY_EXACT : pcntQUERY_PARTIAL ;
+	#else
+	return erFAILURE ;
+	#endif
+}
+
+/**
+ * Build the colour sequences once per report rather than per value
+ */
+static void vPulseCountRenderSGR(void) {
+	snprintfx(caPCsgr[0], pcntSGR_SIZE, "%C", xpfSGR(colourFG_CYAN,0,0,0)) ;
+	snprintfx(caPCsgr[1], pcntSGR_SIZE, "%C", xpfSGR(attrRESET,0,0,0)) ;
+}
+
+/**
+ * Render the report lines of a single channel, into caPCreport
+ * @param	Now		current bucket index per tier, highlighted
+ * @return	pointer to the terminating NUL
+ * @note	with wide scaled values bucket lines are truncated to fit pcntREPORT_SIZE
+ */
+static char * pcPulseCountRender(int Ch, const int * Now) {
+	static const char * const pcTD[pcntTIER_NUM] = { ": MinTD=", "  HourTD=", "  DayTD=", "  MonTD=", "  YearTD=" } ;
+	char * pC = caPCreport ;
+	char * pE = &caPCreport[pcntREPORT_SIZE - 2 * pcntVALUE_SIZE] ;	// room for Year line
+	pC = pcPulseCountU32toA(pC, Ch) ;
+	for (int t = 0; t < pcntTIER_NUM; ++t) {
+		pC = pcPulseCountStr(pC, pcTD[t]) ;
+		pC = pcPulseCountValtoA(pC, Ch, xPulseCountVal(Ch, t, -1)) ;
+	}
+	for (int t = 0; t < pcntTIER_YEAR; ++t) {
+		pC = pcPulseCountStr(pC, "\r\n") ;
+		pC = pcPulseCountStr(pC, sPCtier[t].pcName) ;
+		for (int j = 0; j < sPCtier[t].Depth && pC < pE - 32; ++j) {	// 32 = value, colour & spaces
+			// colour codes only emitted around the current bucket, not for every value
+			if (j == Now[t]) pC = pcPulseCountStr(pC, caPCsgr[0]) ;
+			pC = pcPulseCountValtoA(pC, Ch, xPulseCountVal(Ch, t, j)) ;
+			if (j == Now[t]) pC = pcPulseCountStr(pC, caPCsgr[1]) ;
+			*pC++ = ' ' ; *pC++ = ' ' ;
+		}
+	}
+	pC = pcPulseCountStr(pC, "\r\nYear:  ") ;
+	pC = pcPulseCountValtoA(pC, Ch, xPulseCountVal(Ch, pcntTIER_YEAR, 0)) ;
+	pC = pcPulseCountStr(pC, "\r\n\n") ;
+	*pC = 0 ;
+	return pC ;
+}
+
 void vPulseCountReport(void) {
 	struct tm sTM ;
 	xTimeGMTime(xTimeStampSeconds(sTSZ.usecs), &sTM, 0) ;
+	const int Now[pcntTIER_YEAR] = { sTM.tm_min, sTM.tm_hour, sTM.tm_mday - 1, sTM.tm_mon } ;
+	vPulseCountRenderSGR() ;
+	vPulseCountReadEnter() ;
+	for (int i = 0; i < pcntCH_ALL; ++i) {
+		pcntTIME_START(Start) ;
+		pcPulseCountRender(i, Now) ;
+		pcntTIME_STOP(pcntTIME_REPORT, Start) ;
+		printfx("%s", caPCreport) ;						// single write per channel
+	}
+	vPulseCountReadExit() ;
+}
+
+int xPulseCountExport(int Fmt, int First, int Last, int Tiers, pcntsink_t Sink, void * pvArg) {
+	if (OUTSIDE(pcntFMT_JSON, Fmt, pcntFMT_CBOR) || OUTSIDE(0, First, Last) ||
+		Last >= pcntCH_ALL || Sink == NULL)
+		return erFAILURE;
+	Tiers &= pcntMASK_ALL ;
+	int NumTier = __builtin_popcount(Tiers) ;
+	pcntwr_t sWR = { .Sink = Sink, .pvArg = pvArg, .iRV = erSUCCESS, .Len = 0 } ;
+	vPulseCountReadEnter() ;
+	if (Fmt == pcntFMT_CBOR) vPulseCountWrCBOR(&sWR, 4, Last - First + 1) ;	else vPulseCountWrBytes(&sWR, "[", 1) ;
+	for (int i = First; i <= Last && sWR.iRV == erSUCCESS; ++i) {
+		if (Fmt == pcntFMT_CBOR) {
+			vPulseCountWrCBOR(&sWR, 5, 1 + NumTier) ;
+		} else {
+			vPulseCountWrBytes(&sWR, (i == First) ? "{" : ",{", (i == First) ? 1 : 2) ;
+		}
+		vPulseCountWrKey(&sWR, Fmt, "ch") ;
+		if (Fmt == pcntFMT_CBOR) vPulseCountWrCBOR(&sWR, 0, i) ;	else vPulseCountWrU32(&sWR, i) ;
+		for (int t = 0; t < pcntTIER_NUM; ++t) {
+			if ((Tiers & pcntMASK(t)) == 0) continue ;
+			if (Fmt == pcntFMT_JSON) vPulseCountWrBytes(&sWR, ",", 1) ;
+			vPulseCountWrTier(&sWR, Fmt, i, t) ;
+		}
+		if (Fmt == pcntFMT_JSON) vPulseCountWrBytes(&sWR, "}", 1) ;
+	}
+	if (Fmt == pcntFMT_JSON) vPulseCountWrBytes(&sWR, "]", 1) ;
+	vPulseCountWrFlush(&sWR) ;
+	vPulseCountReadExit() ;
+	return sWR.iRV ;
+}
+
+/* Delta encoding, all integers as unsigned LEB128 varints:
+ *	Seq First Count { SlotGap+1 Value[Count] }... 0
+ * Seq is the sequence number to pass as Since on the next call, slots are in ascending
+ * order with SlotGap the distance from the previous slot (or -1). Values of virtual
+ * channels are signed, zigzag encoded as (v << 1) ^ (v >> 31). */
+static int xPulseCountDeltaStream(u32_t Since, int First, int Last, const u32_t * pu32Seq, int NumSlot,
+									u32_t (* pfValue)(int, int), pcntsink_t Sink, void * pvArg) {
+	if (OUTSIDE(0, First, Last) || Last >= pcntCH_ALL || Sink == NULL)
+		return erFAILURE;
+	pcntwr_t sWR = { .Sink = Sink, .pvArg = pvArg, .iRV = erSUCCESS, .Len = 0 } ;
+	vPulseCountReadEnter() ;
+	vPulseCountWrVarint(&sWR, pcntSeq) ;
+	vPulseCountWrVarint(&sWR, First) ;
+	vPulseCountWrVarint(&sWR, Last - First + 1) ;
+	int Prev = -1 ;
+	for (int Slot = 0; Slot < NumSlot && sWR.iRV == erSUCCESS; ++Slot) {
+		if ((i32_t) (pu32Seq[Slot] - Since) <= 0)
+			continue ;									// unchanged, wrap safe compare
+		vPulseCountWrVarint(&sWR, Slot - Prev) ;
+		Prev = Slot ;
+		for (int i = First; i <= Last; ++i) {
+			u32_t Val = pfValue(i, Slot) ;
+			if (i >= pcntNumCh) Val = (Val << 1) ^ (u32_t) ((i32_t) Val >> 31) ;	// signed, zigzag
+			vPulseCountWrVarint(&sWR, Val) ;
+		}
+	}
+	vPulseCountWrVarint(&sWR, 0) ;
+	vPulseCountWrFlush(&sWR) ;
+	vPulseCountReadExit() ;
+	return sWR.iRV ;
+}
+
+static u32_t xPulseCountSlotValue(int Ch, int Slot) {
+	int t = pcntTIER_YEAR ;
+	while (Slot < sPCtier[t].Base) --t ;
+	return xPulseCountVal(Ch, t, Slot - sPCtier[t].Base) ;
+}
+
+/* Flat bucket numbers are Min 0-59, Hour 60-83, Day 84-114, Mon 115-126, Year 127 */
+int xPulseCountDelta(u32_t Since, int First, int Last, pcntsink_t Sink, void * pvArg) {
+	return xPulseCountDeltaStream(Since, First, Last, u32PCseq, pcntSLOTS, xPulseCountSlotValue, Sink, pvArg) ;
+}
+
+#if (pcntQTR_DAYS > 0)
+static u32_t xPulseCountQtrTerm(int Ch, void * pvArg) {
+	return psPCxtra[Ch].pu16Qtr ? psPCxtra[Ch].pu16Qtr[*(int *) pvArg] : 0 ;
+}
+
+static u32_t xPulseCountQtrValue(int Ch, int Slot) {
+	return (Ch < pcntNumCh) ? xPulseCountQtrTerm(Ch, &Slot) : xPulseCountVirtSum(Ch, xPulseCountQtrTerm, &Slot) ;
+}
+#endif
+
+int xPulseCountQtrDelta(u32_t Since, int First, int Last, pcntsink_t Sink, void * pvArg) {
+	#if (pcntQTR_DAYS > 0)
+	return xPulseCountDeltaStream(Since, First, Last, u32PCqseq, pcntQTR_SLOTS, xPulseCountQtrValue, Sink, pvArg) ;
+	#else
+	(void) Since ; (void) First ; (void) Last ; (void) Sink ; (void) pvArg ;
+	return erFAILURE ;
+	#endif
+}
+
+int xPulseCountCold(int Idx, int Tier, int Ago, int Slot, u32_t * pu32Count) {
+	if (Idx >= pcntNumCh) return xPulseCountVirtRead(Idx, pcntREAD_COLD, Tier, Ago, Slot, pu32Count) ;
+	#if (pcntCOLD_SIZE > 0)
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || OUTSIDE(pcntTIER_MIN, Tier, pcntTIER_DAY) ||
+		Ago < 0 || Slot < 0 || pu32Count == NULL)
+		return erFAILURE ;
+	pcntcold_t * psC = psPCxtra[Idx].psCold ;
+	if (psC == NULL) return erFAILURE ;
+	int Num = 0 ;										// matching records held
+	for (int Ofs = 0; Ofs < psC->Used; Ofs += 2 + psC->Buf[Ofs + 1])
+		if ((psC->Buf[Ofs] >> 6) == Tier) ++Num ;
+	if (Ago >= Num) return erFAILURE ;
+	int Ofs = 0 ;										// skip to record wanted by length
+	for (int Skip = Num - 1 - Ago; ; Ofs += 2 + psC->Buf[Ofs + 1])
+		if ((psC->Buf[Ofs] >> 6) == Tier && Skip-- == 0) break ;
+	if (Slot >= (psC->Buf[Ofs] & 0x3F)) return erFAILURE ;
+	const u8_t * pU8 = &psC->Buf[Ofs + 2] ;
+	u32_t Val = 0, Tok, Run = 0 ;
+	for (int i = 0; i <= Slot; ++i) {					// decode up to slot wanted
+		if (Run) { --Run ; continue ; }
+		pU8 = pu8PulseCountVarintGet(pU8, &Tok) ;
+		if (Tok == 0)
+			pU8 = pu8PulseCountVarintGet(pU8, &Run) ;
+		else
+			Val += (Tok >> 1) ^ -(Tok & 1) ;
+	}
+	*pu32Count = Val ;
+	return erSUCCESS ;
+	#else
+	return erFAILURE ;
+	#endif
+}
+
+int xPulseCountHistory(int Idx, int Tier, int Ago, u32_t * pu32Count) {
+	if (Idx >= pcntNumCh) return xPulseCountVirtRead(Idx, pcntREAD_HIST, Tier, Ago, 0, pu32Count) ;
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || Ago < 0 || pu32Count == NULL) return erFAILURE ;
+	#if (pcntHIST_MONTHS > 0 || pcntHIST_YEARS > 0)
+	pcnthist_t * psH = psPCxtra[Idx].psHist ;
+	if (psH == NULL) return erFAILURE ;
+	#endif
+	#if (pcntHIST_MONTHS > 0)
+	if (Tier == pcntTIER_MON) {
+		if (Ago >= pcntHIST_MONTHS || (u32_t) Ago >= u32PChistMon) return erFAILURE ;
+		*pu32Count = psH->Mon[(u32PChistMon - 1 - Ago) % pcntHIST_MONTHS] ;
+		return erSUCCESS ;
+	}
+	#endif
+	#if (pcntHIST_YEARS > 0)
+	if (Tier == pcntTIER_YEAR) {
+		if (Ago >= pcntHIST_YEARS || (u32_t) Ago >= u32PChistYear) return erFAILURE ;
+		*pu32Count = psH->Year[(u32PChistYear - 1 - Ago) % pcntHIST_YEARS] ;
+		return erSUCCESS ;
+	}
+	#endif
+	return erFAILURE ;
+}
+
+int xPulseCountQtr(int Idx, int Ago, u32_t * pu32Count) {
+	if (Idx >= pcntNumCh) return xPulseCountVirtRead(Idx, pcntREAD_QTR, Ago, 0, 0, pu32Count) ;
+	#if (pcntQTR_DAYS > 0)
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || OUTSIDE(0, Ago, pcntQTR_SLOTS-1) || pu32Count == NULL ||
+		pcntQtrLast < 0 || psPCxtra[Idx].pu16Qtr == NULL)
+		return erFAILURE ;
+	*pu32Count = psPCxtra[Idx].pu16Qtr[(pcntQtrLast + pcntQTR_SLOTS - Ago) % pcntQTR_SLOTS] ;
+	return erSUCCESS ;
+	#else
+	return erFAILURE ;
+	#endif
+}
+
+int xPulseCountScale(int Idx, u32_t Num, u32_t Den, int Dec) {
+	if (OUTSIDE(0, Idx, pcntCH_ALL-1) || OUTSIDE(0, Dec, pcntDEC_MAX) || (Den && Num == 0))
+		return erFAILURE ;
+	// largest value, rounded up, must still fit i64_t in units of 10^-Dec
+	if (Den && (u64_t) 0xFFFFFFFF * Num / Den + 1 > INT64_MAX / u32PCpow10[Dec])
+		return erFAILURE ;
+	pcntscale_t * psS = psPulseCountScale(Idx) ;
+	portENTER_CRITICAL_SAFE(&sPCmux) ;					// report & export never see a half update
+	*psS = (pcntscale_t) { .Num = Num, .Den = Den, .Dec = Dec } ;
+	portEXIT_CRITICAL_SAFE(&sPCmux) ;
+	return erSUCCESS ;
+}
+
+int xPulseCountScaled(int Idx, u32_t Val, i64_t * pi64Val) {
+	if (OUTSIDE(0, Idx, pcntCH_ALL-1) || pi64Val == NULL) return erFAILURE ;
+	bool bNeg ;
+	u64_t Int ;
+	u32_t Frac ;
+	int Dec = xPulseCountScaleSplit(Idx, Val, &bNeg, &Int, &Frac) ;
+	i64_t Res = (Dec > 0) ? Int * u32PCpow10[Dec] + Frac : Int ;
+	*pi64Val = bNeg ? -Res : Res ;
+	return erSUCCESS ;
+}
+
+int xPulseCountVirtual(const pcntterm_t * psTerm, int Num) {
+	#if (pcntVIRT_MAX > 0)
+	if (psPCdata == NULL || pcntVirtNum == pcntVIRT_MAX || pcntCH_ALL > 255 ||
+		OUTSIDE(1, Num, pcntVIRT_TERMS) || psTerm == NULL)
+		return erFAILURE ;
+	for (int i = 0; i < Num; ++i)						// physical channels only
+		if (psTerm[i].Ch >= pcntNumCh) return erFAILURE ;
+	pcntvirt_t * psV = &sPCvirt[pcntVirtNum] ;
+	memcpy(psV->Term, psTerm, Num * sizeof(pcntterm_t)) ;
+	psV->Num = Num ;
+	return pcntNumCh + pcntVirtNum++ ;
+	#else
+	(void) psTerm ; (void) Num ;
+	return erFAILURE ;
+	#endif
+}
+
+int xPulseCountFlow(int Idx, pcntflow_t * psFlow) {
+	#if (pcntOPT_LEAK > 0)
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || psFlow == NULL || psPCxtra[Idx].psLeak == NULL) return erFAILURE ;
+	pcntleak_t * psL = psPCxtra[Idx].psLeak ;
+	psFlow->Run = psL->FlowRun ;
+	psFlow->MinLast = psL->FlowMinLast ;
+	psFlow->Night = psL->NightLast ;
+	psFlow->bLeak = psL->FlowRun >= MINUTES_IN_HOUR * HOURS_IN_DAY ;
+	return erSUCCESS ;
+	#else
+	(void) Idx ; (void) psFlow ;
+	return erFAILURE ;
+	#endif
+}
+
+int xPulseCountTariffSchedule(const pcnttou_t * psSched, int Num) {
+	#if (pcntTARIFFS > 0)
+	if (OUTSIDE(0, Num, 255) || (Num && psSched == NULL)) return erFAILURE ;
+	for (int i = 0; i < Num; ++i)
+		if (psSched[i].Tariff >= pcntTARIFFS || psSched[i].Start >= MINUTES_IN_HOUR * HOURS_IN_DAY)
+			return erFAILURE ;
+	portENTER_CRITICAL_SAFE(&sPCmux) ;					// no lookup on a half updated schedule
+	psPCtou = psSched ;
+	pcntTouNum = Num ;
+	portEXIT_CRITICAL_SAFE(&sPCmux) ;
+	return erSUCCESS ;
+	#else
+	(void) psSched ; (void) Num ;
+	return erFAILURE ;
+	#endif
+}
+
+int xPulseCountTariff(int Idx, int Tariff, bool bLast, u32_t * pu32Count) {
+	if (Idx >= pcntNumCh) return xPulseCountVirtRead(Idx, pcntREAD_TARIFF, Tariff, bLast, 0, pu32Count) ;
+	#if (pcntTARIFFS > 0)
+	if (OUTSIDE(0, Idx, pcntNumCh-1) || OUTSIDE(0, Tariff, pcntTARIFFS-1) || pu32Count == NULL ||
+		psPCxtra[Idx].psTou == NULL)
+		return erFAILURE ;
+	pcnttousum_t * psT = psPCxtra[Idx].psTou ;
+	if (bLast) {
+		*pu32Count = psT->TouLast[Tariff] ;
+	} else {
+		*pu32Count = psT->TouTD[Tariff] ;
+		if (Tariff == pcntTouNow) *pu32Count += xPulseCountTD(&psPCdata[Idx], pcntTIER_MIN) ;
+	}
+	return erSUCCESS ;
+	#else
+	(void) Idx ; (void) Tariff ; (void) bLast ; (void) pu32Count ;
+	return erFAILURE ;
+	#endif
+}
+
+// ############################################ Timing #############################################
+
+int xPulseCountTiming(int Phase, pcnttiming_t * psTiming) {
+	#if (debugTIMING > 0)
+	if (OUTSIDE(0, Phase, pcntTIME_NUM-1) || psTiming == NULL) return erFAILURE ;
+	*psTiming = sPCtime[Phase] ;
+	return erSUCCESS ;
+	#else
+	(void) Phase ; (void) psTiming ;
+	return erFAILURE ;
+	#endif
+}
+
+void vPulseCountTimingReset(void) {
+	#if (debugTIMING > 0)
+	memset(sPCtime, 0, sizeof(sPCtime)) ;
+	#endif
+}
+
+void vPulseCountTimingReport(void) {
+	#if (debugTIMING > 0)
+	for (int p = 0; p < pcntTIME_NUM; ++p) {
+		pcnttiming_t * psT = &sPCtime[p] ;
+		if (psT->Count == 0) continue ;
+		char * pC = pcPulseCountStr(caPCreport, pcPCphase[p]) ;
+		pC = pcPulseCountStr(pC, ": n=") ;		pC = pcPulseCountU32toA(pC, psT->Count) ;
+		pC = pcPulseCountStr(pC, " mean=") ;	pC = pcPulseCountU32toA(pC, psT->Sum / psT->Count) ;
+		pC = pcPulseCountStr(pC, " max=") ;		pC = pcPulseCountU32toA(pC, psT->Max) ;
+		pC = pcPulseCountStr(pC, "  ") ;
+		for (int b = 0; b < pcntTIME_BINS; ++b) {	// "bin:count" for occupied bins only
+			if (psT->Hist[b] == 0) continue ;
+			pC = pcPulseCountU32toA(pC, b) ;	*pC++ = ':' ;
+			pC = pcPulseCountU32toA(pC, psT->Hist[b]) ;	*pC++ = ' ' ;
+		}
+		pC = pcPulseCountStr(pC, "\r\n") ;
+		*pC = 0 ;
+		printfx("%s", caPCreport) ;
+	}
+	#endif
+}
+
+// ########################################### Benchmark ###########################################
+
+#if (pcntOPT_BENCH > 0)
+/* Boundaries measured, each preceded by pulses on every channel. Year end runs
+ * 2023-12-31 23:58 (minute) & 23:59 (month end) into 2024-01-01 00:00 (year) */
+static const struct tm sPCbench[pcntPHASE_NUM] = {
+	[pcntPHASE_MIN]		= { .tm_year = 123, .tm_mon = 11, .tm_mday = 31, .tm_hour = 23, .tm_min = 58 },
+	[pcntPHASE_MEND]	= { .tm_year = 123, .tm_mon = 11, .tm_mday = 31, .tm_hour = 23, .tm_min = 59 },
+	[pcntPHASE_YEAR]	= { .tm_year = 124, .tm_mon = 0,  .tm_mday = 1,  .tm_hour = 0,  .tm_min = 0 },
+	[pcntPHASE_HOUR]	= { .tm_year = 124, .tm_mon = 0,  .tm_mday = 1,  .tm_hour = 1,  .tm_min = 0 },
+	[pcntPHASE_DAY]		= { .tm_year = 124, .tm_mon = 0,  .tm_mday = 2,  .tm_hour = 0,  .tm_min = 0 },
+	[pcntPHASE_MON]		= { .tm_year = 124, .tm_mon = 1,  .tm_mday = 1,  .tm_hour = 0,  .tm_min = 0 },
+} ;
+static const u8_t PCbenchOrder[pcntPHASE_NUM] = {
+	pcntPHASE_MIN, pcntPHASE_MEND, pcntPHASE_YEAR, pcntPHASE_HOUR, pcntPHASE_DAY, pcntPHASE_MON
+} ;
+
+static int xPulseCountBenchSink(void * pvArg, const void * pvBuf, size_t Size) {
+	(void) pvArg ; (void) pvBuf ; (void) Size ;
+	return erSUCCESS ;
+}
+
+static void vPulseCountBenchPulses(int Num) {
+	for (int i = 0; i < pcntNumCh; ++i)
+		for (int j = 0; j < Num; ++j)
+			xPulseCountIncrement(i) ;
+}
+
+int xPulseCountBench(int NumCh, pcntbench_t * psBench) {
+	if (psBench == NULL || psPCdata || xPulseCountInit(NumCh) != erSUCCESS) return erFAILURE ;
+	memset(psBench, 0, sizeof(pcntbench_t)) ;
+	// Increment throughput, below 256 per channel per minute to avoid MinTD wrapping
+	u64_t Start = esp_timer_get_time() ;
+	for (int r = 0; r < pcntBENCH_ROUNDS; ++r) {
+		vPulseCountBenchPulses(200) ;
+		for (int i = 0; i < NumCh; ++i) psPCdata[i].MinTD = 0 ;
+	}
+	u64_t Elapsed = esp_timer_get_time() - Start ;
+	psBench->IncNs = (Elapsed * 1000) / ((u64_t) pcntBENCH_ROUNDS * 200 * NumCh) ;
+	// Rollover latency, worst case per boundary type. The boundaries are not consecutive so
+	// the rollover itself is timed, clock step handling in xPulseCountUpdate() is bypassed
+	for (int r = 0; r < pcntBENCH_ROUNDS; ++r) {
+		for (int p = 0; p < pcntPHASE_NUM; ++p) {
+			int Phase = PCbenchOrder[p] ;
+			struct tm sTM = sPCbench[Phase] ;
+			vPulseCountBenchPulses(1 + (r + p) % 8) ;
+			Start = esp_timer_get_time() ;
+			xPulseCountStep(&sTM) ;
+			Elapsed = esp_timer_get_time() - Start ;
+			if (Elapsed > psBench->UpdUs[Phase]) psBench->UpdUs[Phase] = Elapsed ;
+		}
+	}
+	// Report rendering, excluding output
+	const int Now[pcntTIER_YEAR] = { 0 } ;
+	vPulseCountRenderSGR() ;
+	Start = esp_timer_get_time() ;
+	for (int r = 0; r < pcntBENCH_ROUNDS; ++r)
+		for (int i = 0; i < NumCh; ++i)
+			pcPulseCountRender(i, Now) ;
+	Elapsed = esp_timer_get_time() - Start ;
+	psBench->RenderNs = (Elapsed * 1000) / ((u64_t) pcntBENCH_ROUNDS * NumCh) ;
+	// Export encoding, all tiers of all channels, excluding output
+	u32_t * pu32Ns[] = { [pcntFMT_JSON] = &psBench->JsonNs, [pcntFMT_CBOR] = &psBench->CborNs } ;
+	for (int Fmt = pcntFMT_JSON; Fmt <= pcntFMT_CBOR; ++Fmt) {
+		Start = esp_timer_get_time() ;
+		for (int r = 0; r < pcntBENCH_ROUNDS; ++r)
+			xPulseCountExport(Fmt, 0, NumCh - 1, pcntMASK_ALL, xPulseCountBenchSink, NULL) ;
+		Elapsed = esp_timer_get_time() - Start ;
+		*pu32Ns[Fmt] = (Elapsed * 1000) / ((u64_t) pcntBENCH_ROUNDS * NumCh) ;
+	}
+	vPulseCountDeinit() ;
+	return erSUCCESS ;
+}
+
+// ############################################# Replay ############################################
+
+/* Hourly weights of the default profile, a domestic load curve with morning & evening peaks */
+static const u8_t PCdiurnal[HOURS_IN_DAY] = {
+	2, 1, 1, 1, 1, 2, 5, 9, 8, 6, 5, 5, 6, 5, 4, 4, 5, 7, 10, 11, 9, 7, 5, 3
+} ;
+
+/**
+ * Default replay profile, diurnal curve scaled per channel with a short burst every ~1.6 hours
+ */
+static u32_t xPulseCountReplayDiurnal(int Ch, const struct tm * psTM) {
+	u32_t Min = (psTM->tm_mon * 44641 + psTM->tm_mday * 1440 + psTM->tm_hour * 60 + psTM->tm_min) ;
+	if (((Min + Ch * 7) % 97) == 0) return 250 ;		// burst, just below MinTD wrap
+	return (PCdiurnal[psTM->tm_hour] * (Ch % 4 + 1) + Min % 3) ;
+}
+
+/* Reference calendar, deliberately not using xTimeCalcDaysInMonth() */
+static int xPulseCountReplayDIM(int Year, int Mon) {
+	static const u8_t DIM[MONTHS_IN_YEAR] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 } ;
+	Year += 1900 ;
+	bool bLeap = (Year % 4 == 0 && Year % 100 != 0) || Year % 400 == 0 ;
+	return DIM[Mon] + (Mon == 1 && bLeap) ;
+}
+
+static void vPulseCountReplayCheck(pcntreplay_t * psRes, u32_t Have, u32_t Want, u32_t Mask) {
+	if (Want > Mask) ++psRes->Clipped ;					// bucket too narrow for the period
+	if (Have == (Want & Mask)) return ;
+	if (psRes->Mismatch++ == 0) psRes->FirstBad = psRes->Minutes ;
+}
+
+static void vPulseCountReplayMinute(struct tm * psTM) {
+	if (++psTM->tm_min < MINUTES_IN_HOUR) return ;
+	psTM->tm_min = 0 ;
+	if (++psTM->tm_hour < HOURS_IN_DAY) return ;
+	psTM->tm_hour = 0 ;
+	if (++psTM->tm_mday <= xPulseCountReplayDIM(psTM->tm_year, psTM->tm_mon)) return ;
+	psTM->tm_mday = 1 ;
+	if (++psTM->tm_mon < MONTHS_IN_YEAR) return ;
+	psTM->tm_mon = 0 ;
+	++psTM->tm_year ;
+}
+
+static void vPulseCountReplayBack(struct tm * psTM) {
+	if (--psTM->tm_min >= 0) return ;
+	psTM->tm_min = MINUTES_IN_HOUR - 1 ;
+	if (--psTM->tm_hour >= 0) return ;
+	psTM->tm_hour = HOURS_IN_DAY - 1 ;
+	if (--psTM->tm_mday >= 1) return ;
+	if (--psTM->tm_mon < 0) {
+		psTM->tm_mon = MONTHS_IN_YEAR - 1 ;
+		--psTM->tm_year ;
+	}
+	psTM->tm_mday = xPulseCountReplayDIM(psTM->tm_year, psTM->tm_mon) ;
+}
+
+/* Reference minutes since 1970, deliberately not using xPulseCountEpoch() */
+static u32_t xPulseCountReplayMins(const struct tm * psTM) {
+	u32_t Days = psTM->tm_mday - 1 ;
+	for (int y = 70; y < psTM->tm_year; ++y) Days += 337 + xPulseCountReplayDIM(y, 1) ;	// 365 or 366
+	for (int m = 0; m < psTM->tm_mon; ++m) Days += xPulseCountReplayDIM(psTM->tm_year, m) ;
+	return (Days * HOURS_IN_DAY + psTM->tm_hour) * MINUTES_IN_HOUR + psTM->tm_min ;
+}
+
+static int xPulseCountReplayPhase(const struct tm * psTM) {
+	if (psTM->tm_min == 0) {
+		if (psTM->tm_hour) return pcntPHASE_HOUR ;
+		if (psTM->tm_mday > 1) return pcntPHASE_DAY ;
+		return (psTM->tm_mon == 0) ? pcntPHASE_YEAR : pcntPHASE_MON ;
+	}
+	if (psTM->tm_min == 59 && psTM->tm_hour == 23 &&
+		psTM->tm_mday == xPulseCountReplayDIM(psTM->tm_year, psTM->tm_mon))
+		return pcntPHASE_MEND ;
+	return pcntPHASE_MIN ;
+}
+
+/* Reference clock, last boundary rolled and its minutes since 1970, 0 before the first */
+static struct tm sPCrefTM ;
+static u32_t u32PCrefMin ;
+static bool bPCrefBack ;								// held since a step back
+static bool bPCrefEngine ;								// PulseEngine counts alongside, minute steps only
+
+/* Reference per channel, period counts per tier except pcntTIER_MIN which, with pcntREF_TD,
+ * models the minute as MinTD wrapping at 256 plus what absorbed updates moved aside */
+#define	pcntREF_TD					pcntTIER_NUM
+#define	pcntREF_NUM					(pcntTIER_NUM + 1)
+
+/**
+ * Reference rollover at psTM, compare the buckets persisted with the reference then reset
+ * the periods ended
+ */
+static void vPulseCountReplayRoll(const struct tm * psTM, u32_t (* psRef)[pcntREF_NUM], bool bCheck, pcntreplay_t * psRes) {
+	int Phase = xPulseCountReplayPhase(psTM) ;
 	for (int i = 0; i < pcntNumCh; ++i) {
 		pulsecnt_t * psPC = &psPCdata[i] ;
-		printfx("%d: MinTD=%u  HourTD=%u  DayTD=%u  MonTD=%u  YearTD=%u\r\n",
-				i, psPC->MinTD, psPC->HourTD, psPC->DayTD, psPC->MonTD, psPC->YearTD) ;
-		printfx("Min :  ") ;
-		for (int j = 0; j < MINUTES_IN_HOUR; ++j) {
-			u32_t Col = (j == sTM.tm_min) ? xpfSGR(colourFG_CYAN,0,0,0) : xpfSGR(attrRESET,0,0,0) ;
-			printfx("%C%u%C  ", Col, psPC->Min[j], xpfSGR(attrRESET,0,0,0)) ;
+		u32_t * pRef = psRef[i] ;
+		if (bCheck) {
+			u32_t Min = pRef[pcntTIER_MIN] + pRef[pcntREF_TD] ;
+			if (Min > 0xFF) { ++psRes->Clipped ; Min = 0xFF ; }	// saturates, minute spanning a step back
+			vPulseCountReplayCheck(psRes, xPulseCountBucket(psPC, pcntTIER_MIN, psTM->tm_min), Min, 0xFF) ;
+			if (Phase == pcntPHASE_MEND)
+				for (int d = psTM->tm_mday; d < DAYS_IN_MONTH_MAX; ++d)
+					vPulseCountReplayCheck(psRes, xPulseCountBucket(psPC, pcntTIER_DAY, d), 0, 0xFFFF) ;
+			if (Phase >= pcntPHASE_HOUR && Phase != pcntPHASE_MEND)
+				vPulseCountReplayCheck(psRes, xPulseCountBucket(psPC, pcntTIER_HOUR, psTM->tm_hour), pRef[pcntTIER_HOUR], 0xFF) ;
+			if (Phase >= pcntPHASE_DAY && Phase != pcntPHASE_MEND)
+				vPulseCountReplayCheck(psRes, xPulseCountBucket(psPC, pcntTIER_DAY, psTM->tm_mday - 1), pRef[pcntTIER_DAY], 0xFFFF) ;
+			if (Phase >= pcntPHASE_MON)
+				vPulseCountReplayCheck(psRes, xPulseCountBucket(psPC, pcntTIER_MON, psTM->tm_mon), pRef[pcntTIER_MON], 0xFFFF) ;
+			if (Phase == pcntPHASE_YEAR)
+				vPulseCountReplayCheck(psRes, psPC->Year, pRef[pcntTIER_YEAR], 0xFFFFFFFF) ;
 		}
-		printfx("\r\nHour:  ") ;
-		for (int j = 0; j < HOURS_IN_DAY; ++j) {
-			u32_t Col = (j == sTM.tm_hour) ? xpfSGR(colourFG_CYAN,0,0,0) : xpfSGR(attrRESET,0,0,0) ;
-			printfx("%C%u%C  ", Col, psPC->Hour[j], xpfSGR(attrRESET,0,0,0)) ;
+		pRef[pcntTIER_MIN] = pRef[pcntREF_TD] = 0 ;
+		if (Phase >= pcntPHASE_HOUR && Phase != pcntPHASE_MEND) pRef[pcntTIER_HOUR] = 0 ;
+		if (Phase >= pcntPHASE_DAY && Phase != pcntPHASE_MEND) pRef[pcntTIER_DAY] = 0 ;
+		if (Phase >= pcntPHASE_MON) pRef[pcntTIER_MON] = 0 ;
+		if (Phase == pcntPHASE_YEAR) pRef[pcntTIER_YEAR] = 0 ;
+	}
+}
+
+/**
+ * Compare PulseEngine with the counters, TD counts and the minute bucket just persisted
+ * every minute, all buckets on the hour (after the month end trim of the day before)
+ */
+static void vPulseCountReplayEngine(const struct tm * psTM, pcntreplay_t * psRes) {
+	static const u8_t Depth[pcntTIER_NUM] = { MINUTES_IN_HOUR, HOURS_IN_DAY, DAYS_IN_MONTH_MAX, MONTHS_IN_YEAR, 1 } ;
+	for (int i = 0; i < pcntNumCh; ++i) {
+		pulsecnt_t * psPC = &psPCdata[i] ;
+		for (int t = 0; t < pcntTIER_NUM; ++t) {
+			int First = (t == pcntTIER_MIN) ? psTM->tm_min + 1 : 1 ;
+			int Last = psTM->tm_min == 0 ? Depth[t] : (t == pcntTIER_MIN) ? First : 0 ;
+			for (int s = 0; s <= Last; s = s ? s + 1 : First) {	// Slot 0 = TD, else bucket s-1
+				u32_t Have = s ? xPulseCountBucket(psPC, t, s - 1) : xPulseCountTD(psPC, t) ;
+				u32_t Want ;
+				if (xPulseEngineRead(i, t, s, &Want) == erSUCCESS && Want == Have) continue ;
+				if (psRes->Engine++ == 0) psRes->FirstEngine = psRes->Minutes ;
+			}
 		}
-		printfx("\r\nDay :  ") ;
-		for (int j = 0; j < DAYS_IN_MONTH_MAX; ++j) {
-			u32_t Col = (j == sTM.tm_mday) ? xpfSGR(colourFG_CYAN,0,0,0) : xpfSGR(attrRESET,0,0,0) ;
-			printfx("%C%u%C  ", Col, psPC->Day[j], xpfSGR(attrRESET,0,0,0)) ;
+	}
+}
+
+/**
+ * Update at psTM, roll the reference through the boundaries the clock step policy of
+ * xPulseCountUpdate() requires, then count the pulses of the period following into both
+ */
+static void vPulseCountReplayStep(struct tm * psTM, u32_t (* psRef)[pcntREF_NUM],
+									pcntprofile_t pfProfile, pcntreplay_t * psRes) {
+	int Phase = xPulseCountReplayPhase(psTM) ;
+	u64_t Upd = esp_timer_get_time() ;
+	xPulseCountUpdate(psTM) ;
+	Upd = esp_timer_get_time() - Upd ;
+	if (Upd > psRes->UpdMax[Phase]) psRes->UpdMax[Phase] = Upd ;
+	psRes->UpdSum[Phase] += Upd ;
+	++psRes->UpdNum[Phase] ;
+	if (bPCrefEngine) {
+		xPulseEngineUpdate(psTM) ;
+		vPulseCountReplayEngine(psTM, psRes) ;
+	}
+
+	psRes->Rewrite = u32PCrewrite ;
+	u32_t Now = xPulseCountReplayMins(psTM) ;
+	if (u32PCrefMin == 0 || Now > u32PCrefMin + pcntSTEP_MAX) {
+		vPulseCountReplayRoll(psTM, psRef, u32PCrefMin != 0, psRes) ;	// first or resync
+		sPCrefTM = *psTM ;
+		u32PCrefMin = Now ;
+		bPCrefBack = 0 ;
+	} else if (Now <= u32PCrefMin) {					// held however far back
+		if (Now < u32PCrefMin) bPCrefBack = 1 ;
+		for (int i = 0; bPCrefBack && i < pcntNumCh; ++i) {
+			psRef[i][pcntTIER_MIN] += psRef[i][pcntREF_TD] ;
+			psRef[i][pcntREF_TD] = 0 ;
 		}
-		printfx("\r\nMon :  ") ;
-		for (int j = 0; j < MONTHS_IN_YEAR; ++j) {
-			u32_t Col = (j == sTM.tm_mon) ? xpfSGR(colourFG_CYAN,0,0,0) : xpfSGR(attrRESET,0,0,0) ;
-			printfx("%C%u%C  ", Col, psPC->Mon[j], xpfSGR(attrRESET,0,0,0)) ;
+	} else {											// next or catching up
+		bPCrefBack = 0 ;
+		for (int i = 0; i < pcntSTEP_BATCH && u32PCrefMin < Now; ++i) {
+			vPulseCountReplayMinute(&sPCrefTM) ;
+			++u32PCrefMin ;
+			vPulseCountReplayRoll(&sPCrefTM, psRef, 1, psRes) ;
 		}
-		printfx("\r\nYear:  %u\r\n\n", psPC->Year) ;
 	}
+
+	for (int i = 0; i < pcntNumCh; ++i) {
+		u32_t Num = pfProfile(i, psTM) ;				// pulses during the period starting now
+		if (Num > 0xFF) Num = 0xFF ;					// MinTD width
+		for (u32_t j = 0; j < Num; ++j) xPulseCountIncrement(i) ;
+		for (u32_t j = 0; bPCrefEngine && j < Num; ++j) xPulseEngineIncrement(i) ;
+		for (int t = pcntTIER_HOUR; t < pcntTIER_NUM; ++t) psRef[i][t] += Num ;
+		psRef[i][pcntREF_TD] = (psRef[i][pcntREF_TD] + Num) & 0xFF ;
+		psRes->Pulses += Num ;
+	}
+}
+
+static u32_t (* pvPulseCountReplayInit(int NumCh, pcntreplay_t * psRes))[pcntREF_NUM] {
+	if (psRes == NULL || psPCdata || xPulseCountInit(NumCh) != erSUCCESS) return NULL ;
+	u32_t (* psRef)[pcntREF_NUM] = pvRtosMalloc(NumCh * sizeof(*psRef)) ;
+	if (psRef == NULL) { vPulseCountDeinit() ; return NULL ; }
+	memset(psRef, 0, NumCh * sizeof(*psRef)) ;
+	memset(psRes, 0, sizeof(pcntreplay_t)) ;
+	u32PCrefMin = u32PCrewrite = 0 ;
+	bPCrefBack = bPCrefEngine = 0 ;
+	return psRef ;
+}
+
+int xPulseCountReplay(int NumCh, int Year, pcntprofile_t pfProfile, pcntreplay_t * psRes) {
+	u32_t (* psRef)[pcntREF_NUM] = pvPulseCountReplayInit(NumCh, psRes) ;
+	if (psRef == NULL) return erFAILURE ;
+	if (xPulseEngineInit(NumCh) != erSUCCESS) {
+		vRtosFree(psRef) ;
+		vPulseCountDeinit() ;
+		return erFAILURE ;
+	}
+	bPCrefEngine = 1 ;
+	if (pfProfile == NULL) pfProfile = xPulseCountReplayDiurnal ;
+	struct tm sTM = { .tm_year = Year - 1900, .tm_mday = 1 } ;
+	u64_t Start = esp_timer_get_time() ;
+	do {
+		vPulseCountReplayStep(&sTM, psRef, pfProfile, psRes) ;
+		++psRes->Minutes ;
+		vPulseCountReplayMinute(&sTM) ;
+	} while (sTM.tm_year == Year - 1900 ||				// up to & including 00:00 next year
+			(sTM.tm_mon == 0 && sTM.tm_mday == 1 && sTM.tm_hour == 0 && sTM.tm_min == 0)) ;
+	psRes->WallUs = esp_timer_get_time() - Start ;
+	bPCrefEngine = 0 ;
+	vPulseEngineDeinit() ;
+	vRtosFree(psRef) ;
+	vPulseCountDeinit() ;
+	return (psRes->Mismatch || psRes->Rewrite || psRes->Engine) ? erFAILURE : erSUCCESS ;
+}
+
+// ########################################## Random replay ########################################
+
+static u32_t u32PCrand ;
+
+static u32_t xPulseCountRand(u32_t Range) {				// xorshift32, deterministic per seed
+	u32PCrand ^= u32PCrand << 13 ;
+	u32PCrand ^= u32PCrand >> 17 ;
+	u32PCrand ^= u32PCrand << 5 ;
+	return u32PCrand % Range ;
+}
+
+static u32_t xPulseCountRandPulses(int Ch, const struct tm * psTM) {
+	(void) Ch ; (void) psTM ;
+	switch (xPulseCountRand(8)) {
+	case 0:		return 0 ;
+	case 1:		return 200 + xPulseCountRand(56) ;		// burst, up to MinTD limit
+	default:	return xPulseCountRand(20) ;
+	}
+}
+
+int xPulseCountFuzz(int NumCh, u32_t Seed, u32_t Steps, pcntreplay_t * psRes) {
+	u32_t (* psRef)[pcntREF_NUM] = pvPulseCountReplayInit(NumCh, psRes) ;
+	if (psRef == NULL) return erFAILURE ;
+	u32PCrand = Seed ? Seed : 1 ;
+	struct tm sTM = { .tm_year = 120 + xPulseCountRand(10), .tm_mon = xPulseCountRand(12), .tm_mday = 1 } ;
+	sTM.tm_mday += xPulseCountRand(xPulseCountReplayDIM(sTM.tm_year, sTM.tm_mon)) ;
+	u64_t Start = esp_timer_get_time() ;
+	for (u32_t i = 0; i < Steps; ++i) {
+		vPulseCountReplayStep(&sTM, psRef, xPulseCountRandPulses, psRes) ;
+		int Jump = xPulseCountRand(20) ;				// mostly single minutes, else clock steps
+		if (Jump == 13) continue ;						// same minute again
+		if (Jump == 14 || Jump == 15) {					// back a little or up to 3 hours, absorbed
+			u32_t Num = 1 + xPulseCountRand((Jump == 14) ? 3 : 180) ;
+			while (Num--) vPulseCountReplayBack(&sTM) ;
+			continue ;
+		}
+		u32_t Num = 1 ;
+		if (Jump == 8) Num = 2 + xPulseCountRand(180) ;	// caught up over several calls
+		if (Jump == 16) Num = pcntSTEP_MAX + 1 + xPulseCountRand(30 * 1440) ;	// beyond, resync
+		do {
+			vPulseCountReplayMinute(&sTM) ;
+			++psRes->Minutes ;
+			if (Num) --Num ;
+		} while (Num ||
+			(Jump == 9 && sTM.tm_min != 0) ||
+			(Jump == 10 && (sTM.tm_min || sTM.tm_hour)) ||
+			(Jump == 11 && (sTM.tm_min != 59 || sTM.tm_hour != 23 ||
+							sTM.tm_mday != xPulseCountReplayDIM(sTM.tm_year, sTM.tm_mon))) ||
+			(Jump == 12 && (sTM.tm_min || sTM.tm_hour || sTM.tm_mday != 1))) ;
+		if (sTM.tm_year >= 140) {						// stay well within u32 seconds, start over
+			vPulseCountDeinit() ;
+			if (xPulseCountInit(NumCh) != erSUCCESS) {
+				vRtosFree(psRef) ;
+				return erFAILURE ;
+			}
+			memset(psRef, 0, NumCh * sizeof(*psRef)) ;
+			u32PCrefMin = 0 ;
+			bPCrefBack = 0 ;
+			sTM.tm_year -= 12 ;
+		}
+	}
+	psRes->WallUs = esp_timer_get_time() - Start ;
+	vRtosFree(psRef) ;
+	vPulseCountDeinit() ;
+	return (psRes->Mismatch || psRes->Rewrite) ? erFAILURE : erSUCCESS ;
+}
+
+static bool xPulseCountBenchWorse(u32_t Base, u32_t Now, int Percent) {
+	return (u64_t) Now * 100 > (u64_t) Base * (100 + Percent) + 100 ;	// 1 unit resolution slack
+}
+
+int xPulseCountBenchCheck(const pcntbench_t * psBase, const pcntbench_t * psNow, int Percent) {
+	if (psBase == NULL || psNow == NULL || Percent < 0) return erFAILURE ;
+	if (xPulseCountBenchWorse(psBase->IncNs, psNow->IncNs, Percent) ||
+		xPulseCountBenchWorse(psBase->RenderNs, psNow->RenderNs, Percent) ||
+		xPulseCountBenchWorse(psBase->JsonNs, psNow->JsonNs, Percent) ||
+		xPulseCountBenchWorse(psBase->CborNs, psNow->CborNs, Percent))
+		return erFAILURE ;
+	for (int p = 0; p < pcntPHASE_NUM; ++p)
+		if (xPulseCountBenchWorse(psBase->UpdUs[p], psNow->UpdUs[p], Percent)) return erFAILURE ;
+	return erSUCCESS ;
 }
+#endif
@@ -4,22 +4,567 @@
 
 #pragma once
 
+#include "definitions.h"
+
 #include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// ######################################### Build macros ##########################################
+
+#ifndef pcntRATE_SAMPLES
+	#define	pcntRATE_SAMPLES		8				// timestamps kept for rate, power of 2
+#endif
+
+#ifndef pcntRATE_EMA_SHIFT
+	#define	pcntRATE_EMA_SHIFT		2				// smoothing weight 1/(2^n) per xPulseCountRate() call
+#endif
+
+#ifndef pcntQTR_DAYS
+	#define	pcntQTR_DAYS			1				// days of 15 minute interval data, 0 to disable
+#endif
+
+#ifndef pcntHIST_MONTHS
+	#define	pcntHIST_MONTHS			36				// completed months kept, 0 to disable
+#endif
+
+#ifndef pcntHIST_YEARS
+	#define	pcntHIST_YEARS			10				// completed years kept, 0 to disable
+#endif
+
+#ifndef pcntCOLD_SIZE
+	#define	pcntCOLD_SIZE			256				// bytes/channel compressed history, 0 to disable
+#endif
+
+#ifndef pcntSPARSE_STEP
+	#define	pcntSPARSE_STEP			8				// sparse history grows by this many buckets
+#endif
+
+#ifndef pcntSPARSE_MAX
+	#define	pcntSPARSE_MAX			56				// more non zero buckets switches to dense (break even)
+#endif
+
+#ifndef pcntSPARSE_MIN
+	#define	pcntSPARSE_MIN			40				// at or below at day end switches back to sparse
+#endif
+
+#ifndef pcntOPT_QUERY
+	#define	pcntOPT_QUERY			1				// cumulative stamps for xPulseCountQuery(), 512 bytes/channel
+#endif
+
+#ifndef pcntTARIFFS
+	#define	pcntTARIFFS				3				// time of use tariffs, 0 to disable
+#endif
+
+#ifndef pcntOPT_LEAK
+	#define	pcntOPT_LEAK			1				// continuous flow (leak) detection
+#endif
+
+#ifndef pcntFEAT_INIT
+	#define	pcntFEAT_INIT			pcntFEAT_ALL	// pcntFEAT_? allocated per channel by xPulseCountInit()
+#endif
+
+#ifndef pcntNIGHT_START
+	#define	pcntNIGHT_START			2				// hour night baseline window starts
+#endif
+
+#ifndef pcntNIGHT_HOURS
+	#define	pcntNIGHT_HOURS			2				// length of night baseline window
+#endif
+
+#ifndef pcntVIRT_MAX
+	#define	pcntVIRT_MAX			4				// virtual channels, 0 to disable
+#endif
+
+#ifndef pcntVIRT_TERMS
+	#define	pcntVIRT_TERMS			8				// physical channels per virtual channel
+#endif
+
+#ifndef pcntSTEP_BATCH
+	#define	pcntSTEP_BATCH			60				// missed minutes rolled per call after a forward clock step
+#endif
+
+#ifndef pcntSTEP_MAX
+	#define	pcntSTEP_MAX			(7 * 1440)		// forward clock step (minutes) beyond which to resync
+#endif
+
+#ifndef pcntOPT_BENCH
+	#define	pcntOPT_BENCH			0				// include xPulseCountBench() & xPulseCountReplay()
+#endif
+
+#ifndef pcntBENCH_ROUNDS
+	#define	pcntBENCH_ROUNDS		16				// repetitions per measurement
+#endif
+
+#ifndef pcntTIME_BINS
+	#define	pcntTIME_BINS			24				// log2 cycle histogram bins, last one open ended
+#endif
+
+// ########################################### Macros ##############################################
+
+#define	pcntMASK(t)					(1 << (t))
+#define	pcntMASK_ALL				(pcntMASK(pcntTIER_NUM) - 1)
+
+// ######################################### Enumerations ##########################################
+
+enum { pcntTIER_MIN, pcntTIER_HOUR, pcntTIER_DAY, pcntTIER_MON, pcntTIER_YEAR, pcntTIER_NUM } ;
+
+enum { pcntFMT_JSON, pcntFMT_CBOR } ;
+
+// xPulseCountUpdate() boundary types, MEND being 23:59 on the last day of a month
+enum { pcntPHASE_MIN, pcntPHASE_HOUR, pcntPHASE_DAY, pcntPHASE_MEND, pcntPHASE_MON, pcntPHASE_YEAR, pcntPHASE_NUM } ;
+
+// Timed code paths, xPulseCountUpdate() by boundary type followed by increment & report render
+enum { pcntTIME_INC = pcntPHASE_NUM, pcntTIME_REPORT, pcntTIME_NUM } ;
+
+enum { pcntQUERY_PARTIAL, pcntQUERY_EXACT } ;
+
+// Optional per channel storage, as allocated by xPulseCountInitBudget()
+enum {
+	pcntFEAT_MIN	= (1 << 0),							// minute tier history
+	pcntFEAT_QTR	= (pcntQTR_DAYS > 0) << 1,			// 15 minute interval tier
+	pcntFEAT_COLD	= (pcntCOLD_SIZE > 0) << 2,			// compressed cold history
+	pcntFEAT_QUERY	= (pcntOPT_QUERY > 0) << 3,			// time range query stamps
+	pcntFEAT_STAT	= (1 << 4),							// per tier min/max/mean statistics
+	pcntFEAT_HIST	= (pcntHIST_MONTHS > 0 || pcntHIST_YEARS > 0) << 5,	// month & year history rings
+	pcntFEAT_LEAK	= (pcntOPT_LEAK > 0) << 6,			// continuous flow (leak) detection
+	pcntFEAT_TOU	= (pcntTARIFFS > 0) << 7,			// time of use tariff accumulators
+	pcntFEAT_ALL	= pcntFEAT_MIN | pcntFEAT_QTR | pcntFEAT_COLD | pcntFEAT_QUERY |
+					  pcntFEAT_STAT | pcntFEAT_HIST | pcntFEAT_LEAK | pcntFEAT_TOU,
+} ;
+
 // ########################################## Structures ###########################################
 
+/**
+ * Export output sink, called each time the (bounded) export buffer fills up and at the end.
+ * @param	pvArg	caller supplied context
+ * @param	pvBuf	encoded data
+ * @param	Size	number of bytes in pvBuf
+ * @return	erSUCCESS to continue, any other value aborts the export and is returned to the caller
+ */
+typedef int (* pcntsink_t)(void * pvArg, const void * pvBuf, size_t Size) ;
+
+typedef struct {
+	u8_t Priority ;										// in: 0 = degraded first
+	u8_t Need ;											// in: pcntFEAT_? that must be kept
+	u8_t Have ;											// out: pcntFEAT_? allocated
+	u16_t Bytes ;										// out: worst case bytes for the channel
+} pcnthint_t ;
+
+/**
+ * Alarm callback, called from vPulseCountAlarmService() in task context,
+ * may add or delete alarms, its own included
+ * @param	Value	running count of the tier when serviced, at or above the limit
+ */
+typedef void (* pcntalarmcb_t)(void * pvArg, int Idx, int Tier, u32_t Value) ;
+
+typedef struct {
+	u16_t Run ;											// minutes of uninterrupted flow, up to 65535
+	u8_t MinLast ;										// lowest minute count in the last completed hour
+	bool bLeak ;										// no zero flow minute in the last 24 hours
+	u32_t Night ;										// pulses per hour over the last night window
+} pcntflow_t ;
+
+// Virtual channel term, Weight * physical channel Ch
+typedef struct {
+	u8_t Ch ;
+	i8_t Weight ;
+} pcntterm_t ;
+
+// Time of use schedule entry, Tariff applies from Start until the next entry of the day
+typedef struct {
+	u8_t Days ;											// mask of tm_wday, (1 << 0) = Sunday
+	u8_t Tariff ;										// 0 to pcntTARIFFS-1
+	u16_t Start ;										// minute of the day
+} pcnttou_t ;
+
+typedef struct {
+	u16_t Ovf[pcntTIER_NUM] ;							// channel: TD counter wraps per tier
+	u8_t Peak ;											// channel: most pulses counted in a minute
+	u32_t Rejected ;									// global: increments for an invalid channel
+	u32_t Repeat ;										// global: update calls repeating a minute at :00
+	u32_t Late ;										// global: minutes first seen after :00, rolled late
+	u32_t Skipped ;										// global: minutes not seen, caught up or resynced
+	u32_t StepFwd ;										// global: forward clock steps caught up
+	u32_t StepBack ;									// global: backward clock steps absorbed
+	u32_t Resync ;										// global: forward steps beyond pcntSTEP_MAX
+	u32_t NoMem ;										// global: history buckets dropped, no memory
+} pcnthealth_t ;
+
+typedef struct {
+	u32_t IncNs ;										// mean per xPulseCountIncrement()
+	u32_t UpdUs[pcntPHASE_NUM] ;						// worst xPulseCountUpdate() per boundary type
+	u32_t RenderNs ;									// mean report render per channel, excl output
+	u32_t JsonNs ;										// mean xPulseCountExport() per channel, null sink
+	u32_t CborNs ;
+} pcntbench_t ;
+
+typedef struct {
+	u32_t Count ;										// calls timed
+	u32_t Max ;											// worst case cycles
+	u64_t Sum ;											// total cycles, mean = Sum / Count
+	u32_t Hist[pcntTIME_BINS] ;							// [n] calls taking 2^(n-1) to 2^n-1 cycles
+} pcnttiming_t ;
+
+/**
+ * Replay pulse profile
+ * @param	Ch		channel
+ * @param	psTM	start of the minute
+ * @return	pulses to count during the minute, limited to 255
+ */
+typedef u32_t (* pcntprofile_t)(int Ch, const struct tm * psTM) ;
+
+typedef struct {
+	u32_t Minutes ;										// simulated, SimSec = Minutes * 60
+	u32_t Pulses ;										// total counted, all channels
+	u32_t Mismatch ;									// buckets differing from the reference
+	u32_t FirstBad ;									// minute of first mismatch
+	u32_t Clipped ;										// periods exceeding the bucket width
+	u32_t Rewrite ;										// boundaries rolled at or before an earlier one
+	u32_t Engine ;										// PulseEngine counts differing, xPulseCountReplay() only
+	u32_t FirstEngine ;									// minute of first engine difference
+	u64_t WallUs ;										// elapsed time for the replay
+	u32_t UpdMax[pcntPHASE_NUM] ;						// worst xPulseCountUpdate() per boundary type
+	u64_t UpdSum[pcntPHASE_NUM] ;						// total, mean = UpdSum / UpdNum
+	u32_t UpdNum[pcntPHASE_NUM] ;
+} pcntreplay_t ;
+
+typedef struct {
+	u32_t Min, Max, Mean ;								// bucket values over the period
+	u8_t MinIdx, MaxIdx ;								// bucket index of minimum & peak
+	u8_t Count ;										// buckets persisted in the period
+} pcntstats_t ;
+
 
 // ############################################ global functions ###################################
 
+/**
+ * Initialise NumCh channels, each with the pcntFEAT_INIT features (default all), see
+ * xPulseCountInitBudget() for targets that can not afford that on every channel
+ */
 int xPulseCountInit(int);
+
+/**
+ * Initialise within a RAM budget, starting from all features on every channel and then
+ * removing time range query stamps, cold history, statistics, leak detection, month & year
+ * history, 15 minute intervals, tariffs and the minute tier in that order from the lowest
+ * priority channel first until the worst case fits. Features are kept or dropped whole,
+ * their depth is fixed at build time by pcntOPT_QUERY, pcntCOLD_SIZE, pcntHIST_MONTHS,
+ * pcntHIST_YEARS, pcntQTR_DAYS and pcntTARIFFS.
+ * @param	NumCh	number of channels
+ * @param	Budget	bytes available for counter data
+ * @param	psHint	NumCh entries, Priority & Need supplied, Have & Bytes returned as the layout
+ * @return	erSUCCESS or erFAILURE if parameters invalid, Need can not be met within Budget or no memory
+ */
+int xPulseCountInitBudget(int NumCh, size_t Budget, pcnthint_t * psHint);
+/**
+ * Release all counter memory, xPulseCountInit() can be called again afterwards
+ */
+void vPulseCountDeinit(void);
 int xPulseCountUpdate(struct tm *);
 int xPulseCountIncrement(int);
+
+/**
+ * Health counters, accumulated since init or the last clear
+ * @param	Idx		channel, or -1 for global counters only (channel fields 0)
+ * @param	bClear	reset the counters read, channel or global
+ * @param	psHealth	receives global counters and, if Idx valid, those of the channel
+ * @return	erSUCCESS or erFAILURE if parameters invalid
+ */
+int xPulseCountHealth(int Idx, bool bClear, pcnthealth_t * psHealth);
+
+/**
+ * Rolling window total over all retained completed buckets of a tier, maintained
+ * incrementally at rollover so reading is O(1).
+ * @param	Idx		channel
+ * @param	Tier	pcntTIER_MIN (last 60 minutes), pcntTIER_HOUR (last 24 hours) or
+ * 					pcntTIER_DAY (last 28~31 days, Day[] is calendar aligned & trimmed at month end)
+ * @return	window total, 0 if parameters invalid
+ * @note	excludes the running TD count of the tier
+ */
+u32_t xPulseCountWindow(int Idx, int Tier);
+
+/**
+ * Total pulses counted in the range [T0, T1), resolved to the nearest retained bucket boundary
+ * using cumulative totals stamped at each rollover, cost O(tiers) irrespective of range length.
+ * @param	Idx		channel
+ * @param	T0		range start, seconds in the timebase of the struct tm passed to xPulseCountUpdate()
+ * @param	T1		range end, after the last rollover includes the running (current minute) count
+ * @param	pu32Sum	receives the range total
+ * @return	pcntQUERY_EXACT if both ends are on retained boundaries, pcntQUERY_PARTIAL if an end
+ * 			had to be rounded down to a coarser boundary, lies beyond retention or after the
+ * 			last rollover, erFAILURE if parameters invalid or pcntOPT_QUERY disabled
+ */
+int xPulseCountQuery(int Idx, u32_t T0, u32_t T1, u32_t * pu32Sum);
+
+/**
+ * Statistics of the buckets of a tier over the current, or last completed, parent period
+ * i.e. minutes of an hour, hours of a day, days of a month and months of a year.
+ * Maintained as each bucket is persisted so reading is O(1).
+ * @param	Idx		channel
+ * @param	Tier	pcntTIER_MIN -> pcntTIER_MON
+ * @param	bLast	0 = period in progress, 1 = last completed period
+ * @param	psStats	receives the statistics
+ * @return	erSUCCESS or erFAILURE if parameters invalid or pcntFEAT_STAT not allocated
+ * @note	completed month Mean is per calendar day (xTimeCalcDaysInMonth), others per bucket persisted
+ */
+int xPulseCountStats(int Idx, int Tier, bool bLast, pcntstats_t * psStats);
+
+/**
+ * Enable or disable instantaneous rate tracking, when enabled xPulseCountIncrement()
+ * stores a microsecond timestamp of each pulse in a ring of pcntRATE_SAMPLES entries.
+ * @param	Idx			channel
+ * @param	TimeoutMs	0 to disable, else period without pulses after which rate reads as 0, up to 1 hour
+ * @return	erSUCCESS or erFAILURE if parameters invalid or no memory
+ */
+int xPulseCountRateEnable(int Idx, u32_t TimeoutMs);
+
+/**
+ * Add an alarm firing once per period of a tier when its running count reaches Limit,
+ * e.g. pcntTIER_DAY 500 for 500 pulses today or pcntTIER_MIN 101 for more than 100 in a minute.
+ * Re-armed when the tier rolls over. Per pulse cost is a single compare per channel.
+ * @param	Idx		channel
+ * @param	Tier	pcntTIER_MIN -> pcntTIER_YEAR
+ * @param	Limit	count at which the alarm fires, 1 to 255 (MIN, HOUR), 65535 (DAY, MON)
+ * @param	pfCB	callback, from vPulseCountAlarmService()
+ * @return	erSUCCESS or erFAILURE if parameters invalid or no memory
+ */
+int xPulseCountAlarmAdd(int Idx, int Tier, u32_t Limit, pcntalarmcb_t pfCB, void * pvArg);
+
+/**
+ * Remove the alarm added with the same channel, tier and limit
+ * @return	erSUCCESS or erFAILURE if not found
+ */
+int xPulseCountAlarmDel(int Idx, int Tier, u32_t Limit);
+
+/**
+ * Call callbacks of alarms tripped since the last call, from the task calling
+ * xPulseCountUpdate() as often as reaction time requires, returns at once if none tripped.
+ */
+void vPulseCountAlarmService(void);
+
+/**
+ * Instantaneous rate over the last pcntRATE_SAMPLES pulses and an exponentially smoothed rate,
+ * the smoothed value is advanced on each call so should be read at a regular interval.
+ * @param	Idx			channel
+ * @param	pu32Inst	receives instantaneous rate in milli-pulses per second, can be NULL
+ * @param	pu32Smooth	receives smoothed rate in milli-pulses per second, can be NULL
+ * @return	erSUCCESS or erFAILURE if parameters invalid or rate tracking not enabled
+ */
+int xPulseCountRate(int Idx, u32_t * pu32Inst, u32_t * pu32Smooth);
+
+/**
+ * Enable or disable the sub-minute tier of a channel, a ring of per interval counts for the
+ * current minute fed by vPulseCountSecTick(), channels not enabled cost no memory or time.
+ * @param	Idx		channel
+ * @param	Period	interval in seconds, must divide 60 evenly, 0 to disable
+ * @return	erSUCCESS or erFAILURE if parameters invalid or no memory
+ */
+int xPulseCountSecEnable(int Idx, int Period);
+
+/**
+ * Close sub-minute intervals ending at this second, call once per second from the task
+ * that calls xPulseCountUpdate(). The last interval of each minute is closed at rollover.
+ * A missed call merges the interval into the next one and reads 0, no pulses are lost.
+ */
+void vPulseCountSecTick(struct tm * psTM);
+
+/**
+ * Count of a completed sub-minute interval
+ * @param	Idx		channel
+ * @param	Ago		0 = most recently completed interval, up to (60/Period)-1
+ * @param	pu32Count	receives the count
+ * @return	erSUCCESS or erFAILURE if parameters invalid or tier not enabled
+ */
+int xPulseCountSec(int Idx, int Ago, u32_t * pu32Count);
+
+/**
+ * Read a bucket from compressed cold history, completed periods are run length and delta
+ * encoded at rollover and kept, oldest first out, within pcntCOLD_SIZE bytes per channel.
+ * @param	Idx		channel
+ * @param	Tier	pcntTIER_MIN (minutes of past hours), pcntTIER_HOUR (hours of past days)
+ * 					or pcntTIER_DAY (days of past months)
+ * @param	Ago		0 = most recently completed hour/day/month
+ * @param	Slot	position in the period, 0 = first minute/hour/day
+ * @param	pu32Count	receives the bucket value
+ * @return	erSUCCESS or erFAILURE if parameters invalid or no longer retained
+ */
+int xPulseCountCold(int Idx, int Tier, int Ago, int Slot, u32_t * pu32Count);
+
+/**
+ * Long term history, totals of completed months and years beyond the Mon[] and Year buckets
+ * @param	Idx		channel
+ * @param	Tier	pcntTIER_MON (up to pcntHIST_MONTHS) or pcntTIER_YEAR (up to pcntHIST_YEARS)
+ * @param	Ago		0 = most recently completed month/year
+ * @param	pu32Count	receives the total
+ * @return	erSUCCESS or erFAILURE if parameters invalid, pcntFEAT_HIST not allocated or not (yet) retained
+ */
+int xPulseCountHistory(int Idx, int Tier, int Ago, u32_t * pu32Count);
+
+/**
+ * Count of a completed 15 minute interval, retained for pcntQTR_DAYS days
+ * @param	Idx		channel
+ * @param	Ago		0 = most recently completed interval
+ * @param	pu32Count	receives the count
+ * @return	erSUCCESS or erFAILURE if parameters invalid, no interval completed or tier disabled
+ */
+int xPulseCountQtr(int Idx, int Ago, u32_t * pu32Count);
+
+/**
+ * As xPulseCountDelta() for the 15 minute interval tier, slot numbers are
+ * (days since 1970 % pcntQTR_DAYS) * 96 + interval of the day, labelled by interval start.
+ */
+int xPulseCountQtrDelta(u32_t Since, int First, int Last, pcntsink_t Sink, void * pvArg);
+
+/**
+ * Define a virtual channel as a linear combination of physical channels, e.g. net = import - export
+ * or {main, -sub1, -sub2} for unmetered consumption. Evaluated from the terms on every read,
+ * nothing is stored or done at rollover or in the increment path.
+ * Report, export, delta, window, query, history, 15 minute, cold and tariff reads accept the
+ * index returned, values are signed (i32_t) carried in u32_t, in export as signed integers.
+ * Rate, seconds, stats, flow, alarms and health are for physical channels only.
+ * @param	psTerm	terms, physical channels only
+ * @param	Num		1 to pcntVIRT_TERMS
+ * @return	virtual channel index (after the physical channels) or erFAILURE if parameters
+ * 			invalid, not initialised or pcntVIRT_MAX reached
+ */
+int xPulseCountVirtual(const pcntterm_t * psTerm, int Num);
+
+/**
+ * Set engineering unit scaling of a channel, applied to report & export output only,
+ * stored counts are unchanged so a new calibration applies to all history at once.
+ * Output is Value * Num / Den with Dec decimals, exact integer arithmetic, rounded half
+ * away from zero, e.g. 1000 pulses/kWh as Num 1, Den 1000, Dec 3 for kWh to 1 Wh.
+ * @param	Idx		channel, physical or virtual
+ * @param	Den		0 for raw counts
+ * @param	Dec		decimals, 0 to 9
+ * @return	erSUCCESS or erFAILURE if parameters invalid, or if 0xFFFFFFFF * Num / Den
+ * 			with Dec decimals would not fit i64_t
+ * @note	delta streams remain in raw counts
+ */
+int xPulseCountScale(int Idx, u32_t Num, u32_t Den, int Dec);
+
+/**
+ * Scale a value (bucket or count read from the channel) as the report & export do
+ * @param	pi64Val	receives the value in units of 10^-Dec
+ * @return	erSUCCESS or erFAILURE if parameters invalid
+ */
+int xPulseCountScaled(int Idx, u32_t Val, i64_t * pi64Val);
+
+/**
+ * Continuous flow status, maintained incrementally at each minute rollover
+ * @param	Idx		channel
+ * @param	psFlow	receives run length, hourly minimum, night baseline & leak flag
+ * @return	erSUCCESS or erFAILURE if parameters invalid, pcntOPT_LEAK disabled or pcntFEAT_LEAK not allocated
+ */
+int xPulseCountFlow(int Idx, pcntflow_t * psFlow);
+
+/**
+ * Set the time of use schedule, evaluated at each minute rollover. Minutes before the first
+ * entry of a day, or without a schedule, count towards tariff 0.
+ * @param	psSched	entries, any order, must remain valid while in use
+ * @param	Num		number of entries, 0 to remove the schedule
+ * @return	erSUCCESS or erFAILURE if an entry is invalid or tariffs disabled
+ */
+int xPulseCountTariffSchedule(const pcnttou_t * psSched, int Num);
+
+/**
+ * Pulses counted under a tariff during a billing (calendar) month
+ * @param	Idx		channel
+ * @param	Tariff	0 to pcntTARIFFS-1
+ * @param	bLast	0 = month in progress (includes the current minute), 1 = last completed month
+ * @param	pu32Count	receives the total
+ * @return	erSUCCESS or erFAILURE if parameters invalid, tariffs disabled or pcntFEAT_TOU not allocated
+ */
+int xPulseCountTariff(int Idx, int Tariff, bool bLast, u32_t * pu32Count);
+
 void vPulseCountReport(void);
 
+/**
+ * CPU cycles spent in a timed code path, recorded only if counter.c is built with debugTIMING
+ * @param	Phase	pcntPHASE_? for xPulseCountUpdate() by boundary type, pcntTIME_INC or pcntTIME_REPORT
+ * @param	psTiming	receives count, worst case, total and log2 histogram
+ * @return	erSUCCESS or erFAILURE if parameters invalid or timing not built in
+ */
+int xPulseCountTiming(int Phase, pcnttiming_t * psTiming);
+void vPulseCountTimingReset(void);
+
+/**
+ * One line per timed code path: name, count, mean & max cycles and occupied "bin:count" pairs
+ */
+void vPulseCountTimingReport(void);
+
+#if (pcntOPT_BENCH > 0)
+/**
+ * Measure increment throughput, rollover latency at each boundary type, report rendering and
+ * JSON & CBOR export with NumCh channels, using a private counter set that is released again when done.
+ * Call before xPulseCountInit() or after vPulseCountDeinit(), pcntOPT_BENCH must be defined.
+ * @param	NumCh	channels, 1 to 255
+ * @param	psBench	receives the results
+ * @return	erSUCCESS or erFAILURE if parameters invalid, counters in use or no memory
+ */
+int xPulseCountBench(int NumCh, pcntbench_t * psBench);
+
+/**
+ * Replay a calendar year, 1 January 00:00 to 00:00 the next year, a minute at a time on a
+ * virtual clock, injecting pulses from a profile and checking every persisted bucket against
+ * an independent reference with the same bucket widths. PulseEngine (counter_engine.h) counts
+ * the same pulses and must match every TD count and bucket. Same conditions as xPulseCountBench()
+ * @param	NumCh		channels, 1 to 255
+ * @param	Year		e.g. 2024 to include 29 February
+ * @param	pfProfile	pulses per channel per minute, NULL for a diurnal curve with bursts
+ * @param	psRes		receives counts, mismatches and cost per boundary type
+ * @return	erSUCCESS, erFAILURE if parameters invalid, counters in use, no memory or mismatches
+ */
+int xPulseCountReplay(int NumCh, int Year, pcntprofile_t pfProfile, pcntreplay_t * psRes);
+
+/**
+ * Randomised replay, as xPulseCountReplay() but with random pulse counts, bursts and clock
+ * jumps of up to 3 hours, to the next hour, day, month end or month boundary, repeated
+ * minutes, backward steps of up to 3 hours and forward steps beyond pcntSTEP_MAX. The
+ * reference follows the catch up, absorb and resync rules of xPulseCountUpdate() and any
+ * boundary rolled again, which would overwrite completed buckets, fails the replay.
+ * Repeatable for a given Seed.
+ * @param	Steps	number of xPulseCountUpdate() calls
+ */
+int xPulseCountFuzz(int NumCh, u32_t Seed, u32_t Steps, pcntreplay_t * psRes);
+
+/**
+ * Performance gate, compare xPulseCountBench() results against a stored baseline
+ * @param	Percent	allowed increase of any measurement, +1 unit for timer resolution
+ * @return	erSUCCESS or erFAILURE if parameters invalid or any measurement regressed
+ */
+int xPulseCountBenchCheck(const pcntbench_t * psBase, const pcntbench_t * psNow, int Percent);
+#endif
+
+/**
+ * Stream TD counters and buckets of a range of channels as JSON or CBOR.
+ * @param	Fmt		pcntFMT_JSON or pcntFMT_CBOR
+ * @param	First	first channel to export
+ * @param	Last	last channel to export (inclusive)
+ * @param	Tiers	mask of tiers to export, pcntMASK(pcntTIER_?) or pcntMASK_ALL
+ * @param	Sink	output function
+ * @param	pvArg	context passed to Sink
+ * @return	erSUCCESS, erFAILURE if parameters invalid, else first error returned by Sink
+ */
+int xPulseCountExport(int Fmt, int First, int Last, int Tiers, pcntsink_t Sink, void * pvArg);
+
+/**
+ * Stream, in compact binary form, only buckets persisted after sequence number Since.
+ * Every xPulseCountUpdate() rollover advances the sequence number, the encoded stream
+ * starts with the current value which should be passed as Since on the next call.
+ * Values of virtual channels are signed and zigzag encoded, physical ones unsigned.
+ * @param	Since	sequence number from the previous call, 0 for all written buckets
+ * @param	First	first channel to export
+ * @param	Last	last channel to export (inclusive)
+ * @param	Sink	output function
+ * @param	pvArg	context passed to Sink
+ * @return	erSUCCESS, erFAILURE if parameters invalid, else first error returned by Sink
+ */
+int xPulseCountDelta(u32_t Since, int First, int Last, pcntsink_t Sink, void * pvArg);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,19 @@
+/*
+ * counter_engine.cpp - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ */
+
+#include "counter_engine.h"
+#include "counter_engine.hpp"
+
+// ########################################## Structures ###########################################
+
+using pcntengine_t = pcnt::Engine<
+	pcnt::Tier<pcnt::EveryMinute,	u8_t,	MINUTES_IN_HOUR>,
+	pcnt::Tier<pcnt::EveryHour,		u8_t,	HOURS_IN_DAY>,
+	pcnt::Tier<pcnt::EveryDay,		u16_t,	DAYS_IN_MONTH_MAX>,
+	pcnt::Tier<pcnt::EveryMonth,	u16_t,	MONTHS_IN_YEAR>,
+	pcnt::Tier<pcnt::EveryYear,		u32_t,	1> > ;
+
+// ########################################### Public functions ####################################
+
+pcntENGINE_C_API(PulseEngine, pcntengine_t)
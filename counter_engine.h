@@ -0,0 +1,34 @@
+/*
+ * counter_engine.h - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * C interface to engines instantiated from counter_engine.hpp with pcntENGINE_C_API()
+ */
+
+#pragma once
+
+#include "definitions.h"
+
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ########################################### Macros ##############################################
+
+#define	pcntENGINE_C_DECL(N)											\
+	int x##N##Init(int NumCh) ;											\
+	void v##N##Deinit(void) ;											\
+	int x##N##Update(struct tm * psTM) ;								\
+	int x##N##Increment(int Idx) ;										\
+	int x##N##Read(int Idx, int Tier, int Slot, u32_t * pu32) ;
+
+// ############################################ global functions ###################################
+
+/* Default engine, same hierarchy and widths as pulsecnt_t, tiers numbered as pcntTIER_?
+ * Read Slot 0 returns the TD count, Slot 1..depth the buckets */
+pcntENGINE_C_DECL(PulseEngine)
+
+#ifdef __cplusplus
+}
+#endif
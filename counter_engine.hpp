@@ -0,0 +1,248 @@
+/*
+ * counter_engine.hpp - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Header only pulse counter engine with the tier hierarchy described by template parameters.
+ * Each tier is a rollover rule, bucket type and depth, for example the classic pulsecnt_t
+ *
+ *	using Classic = pcnt::Engine<
+ *		pcnt::Tier<pcnt::EveryMinute,	u8_t,	MINUTES_IN_HOUR>,
+ *		pcnt::Tier<pcnt::EveryHour,		u8_t,	HOURS_IN_DAY>,
+ *		pcnt::Tier<pcnt::EveryDay,		u16_t,	DAYS_IN_MONTH_MAX>,
+ *		pcnt::Tier<pcnt::EveryMonth,	u16_t,	MONTHS_IN_YEAR>,
+ *		pcnt::Tier<pcnt::EveryYear,		u32_t,	1> > ;
+ *
+ * and a 15 minute billing hierarchy without a minute tier
+ *
+ *	using Billing = pcnt::Engine<
+ *		pcnt::Tier<pcnt::EveryMinutes<15>,	u16_t,	96>,
+ *		pcnt::Tier<pcnt::EveryDay,			u16_t,	DAYS_IN_MONTH_MAX>,
+ *		pcnt::Tier<pcnt::EveryWeek,			u32_t,	53> > ;
+ *
+ * Tiers are listed finest first and must nest, each boundary of a tier also being a boundary
+ * of the preceding one (a week tier can follow days but not precede months).
+ * Increment and rollover are expanded per tier at compile time, there are no tier tables
+ * consulted at runtime. Use pcntENGINE_C_API() in a single .cpp to expose an engine to C.
+ */
+
+#pragma once
+
+#include "definitions.h"
+#include "x_errors_events.h"
+#include "hal_platform.h"
+
+#include <ctime>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace pcnt {
+
+// ######################################## Rollover rules #########################################
+
+/* Rules are evaluated at HH:MM:00, due() decides if the tier rolls over at this boundary,
+ * each test being complete on its own (not chained to finer rules), and slot() selects the
+ * bucket the finished period is persisted into, reduced modulo the tier depth only if the
+ * rule can produce more than depth (slots) distinct values.
+ * As with xPulseCountUpdate() the slot is that of the boundary, not of the period ended. */
+
+struct RuleBase {
+	static constexpr bool trims = false ;					// rule has end of period trim
+	static constexpr bool trimming(const struct tm &) { return false ; }
+	template <typename T, std::size_t N> static void trim(const struct tm &, T *) {}
+	static int DaysInMonth(const struct tm & sTM) { return xTimeCalcDaysInMonth(const_cast<struct tm *>(&sTM)) ; }
+} ;
+
+struct EveryMinute : RuleBase {
+	static constexpr unsigned slots = MINUTES_IN_HOUR ;
+	static constexpr bool due(const struct tm &) { return true ; }
+	static constexpr unsigned slot(const struct tm & sTM) { return sTM.tm_min ; }
+} ;
+
+template <unsigned M> struct EveryMinutes : RuleBase {
+	static constexpr unsigned slots = MINUTES_IN_HOUR * HOURS_IN_DAY / M ;
+	static_assert(M && (MINUTES_IN_HOUR * HOURS_IN_DAY) % M == 0, "period must divide a day") ;
+	static constexpr bool due(const struct tm & sTM) { return (sTM.tm_hour * MINUTES_IN_HOUR + sTM.tm_min) % M == 0 ; }
+	static constexpr unsigned slot(const struct tm & sTM) { return (sTM.tm_hour * MINUTES_IN_HOUR + sTM.tm_min) / M ; }
+} ;
+
+struct EveryHour : RuleBase {
+	static constexpr unsigned slots = HOURS_IN_DAY ;
+	static constexpr bool due(const struct tm & sTM) { return sTM.tm_min == 0 ; }
+	static constexpr unsigned slot(const struct tm & sTM) { return sTM.tm_hour ; }
+} ;
+
+struct EveryDay : RuleBase {
+	static constexpr unsigned slots = DAYS_IN_MONTH_MAX ;
+	static constexpr bool due(const struct tm & sTM) { return sTM.tm_min == 0 && sTM.tm_hour == 0 ; }
+	static constexpr unsigned slot(const struct tm & sTM) { return sTM.tm_mday - 1 ; }
+	/* At 23:59.00 of the last day in the month ZERO remaining (not in month) days, as counter.c
+	 * The engine only calls trim() once it established that this is such a boundary */
+	static constexpr bool trims = true ;
+	static bool trimming(const struct tm & sTM) {
+		return sTM.tm_min == 59 && sTM.tm_hour == 23 && sTM.tm_mday == DaysInMonth(sTM) ;
+	}
+	template <typename T, std::size_t N> static void trim(const struct tm & sTM, T * pBucket) {
+		for (int i = sTM.tm_mday; i < (int) N; ++i)
+			pBucket[i] = 0 ;
+	}
+} ;
+
+struct EveryWeek : RuleBase {								// Monday 00:00
+	static constexpr unsigned slots = 53 ;
+	static constexpr bool due(const struct tm & sTM) { return sTM.tm_min == 0 && sTM.tm_hour == 0 && sTM.tm_wday == 1 ; }
+	static constexpr unsigned slot(const struct tm & sTM) { return sTM.tm_yday / 7 ; }
+} ;
+
+struct EveryMonth : RuleBase {
+	static constexpr unsigned slots = MONTHS_IN_YEAR ;
+	static constexpr bool due(const struct tm & sTM) { return sTM.tm_min == 0 && sTM.tm_hour == 0 && sTM.tm_mday == 1 ; }
+	static constexpr unsigned slot(const struct tm & sTM) { return sTM.tm_mon ; }
+} ;
+
+struct EveryYear : RuleBase {
+	static constexpr unsigned slots = 0 ;					// unbounded, always modulo depth
+	static constexpr bool due(const struct tm & sTM) { return sTM.tm_min == 0 && sTM.tm_hour == 0 && sTM.tm_mday == 1 && sTM.tm_mon == 0 ; }
+	static constexpr unsigned slot(const struct tm & sTM) { return sTM.tm_year ; }
+} ;
+
+// ############################################# Tiers #############################################
+
+template <typename Rule, typename T, std::size_t N>
+struct Tier {
+	static_assert(N > 0, "tier needs at least one bucket") ;
+	using rule = Rule ;
+	using value_type = T ;
+	static constexpr std::size_t depth = N ;
+
+	T TD ;
+	T Bucket[N] ;
+
+	void increment() { ++TD ; }
+	void trim(const struct tm & sTM) { if constexpr (Rule::trims) Rule::template trim<T, N>(sTM, Bucket) ; }
+	bool rollover(const struct tm & sTM) {
+		if (!Rule::due(sTM))
+			return false ;
+		if constexpr (N == 1)
+			Bucket[0] = TD ;
+		else if constexpr (Rule::slots && Rule::slots <= N)
+			Bucket[Rule::slot(sTM)] = TD ;
+		else
+			Bucket[Rule::slot(sTM) % N] = TD ;
+		TD = 0 ;
+		return true ;
+	}
+} ;
+
+// ######################################## Single channel #########################################
+
+template <typename... Tiers>
+class Counter {
+	static_assert(sizeof...(Tiers) > 0, "at least one tier required") ;
+	std::tuple<Tiers...> sTiers ;
+
+	template <std::size_t... I>
+	bool read(unsigned Tier, unsigned Slot, u32_t & Val, std::index_sequence<I...>) const {
+		return ((Tier == I && Slot <= std::tuple_element_t<I, std::tuple<Tiers...>>::depth &&
+				(Val = Slot ? std::get<I>(sTiers).Bucket[Slot - 1] : std::get<I>(sTiers).TD, true)) || ...) ;
+	}
+
+public:
+	static constexpr std::size_t tiers = sizeof...(Tiers) ;
+
+	/* Trim conditions depend on time only, evaluate once per update for all channels */
+	static bool trimming(const struct tm & sTM) {
+		return (Tiers::rule::trimming(sTM) || ...) ;
+	}
+
+	void increment() { std::apply([](auto &... sT) { (sT.increment(), ...) ; }, sTiers) ; }
+	/* Cascade as xPulseCountUpdate(), stop at the first tier not rolling over. Hence tiers
+	 * must be ordered so that every boundary of a tier is also one of the preceding tier */
+	void rollover(const struct tm & sTM, bool bTrim) {
+		std::apply([&sTM](auto &... sT) { (sT.rollover(sTM) && ...) ; }, sTiers) ;
+		if (bTrim)
+			std::apply([&sTM](auto &... sT) { (sT.trim(sTM), ...) ; }, sTiers) ;
+	}
+	template <std::size_t I> auto & tier() { return std::get<I>(sTiers) ; }
+	template <std::size_t I> const auto & tier() const { return std::get<I>(sTiers) ; }
+
+	/**
+	 * Runtime access for C, Slot 0 is the TD count, 1..depth the buckets
+	 */
+	bool read(unsigned Tier, unsigned Slot, u32_t & Val) const {
+		return read(Tier, Slot, Val, std::index_sequence_for<Tiers...>{}) ;
+	}
+} ;
+
+// ########################################## All channels #########################################
+
+template <typename... Tiers>
+class Engine {
+	Counter<Tiers...> * psData = nullptr ;
+	int NumCh = 0 ;
+	int LastMin = -1 ;
+
+public:
+	using counter_type = Counter<Tiers...> ;
+	static_assert(std::is_trivially_destructible_v<counter_type>, "released without destruction") ;
+
+	/* Same heap as counter.c, channels value initialised (all counts 0) */
+	int init(int Num) {
+		if (OUTSIDE(0, Num, 255) || psData) return erFAILURE ;
+		psData = static_cast<counter_type *>(pvRtosMalloc(Num * sizeof(counter_type))) ;
+		if (psData == nullptr) return erFAILURE ;
+		for (int i = 0; i < Num; ++i)
+			new (&psData[i]) counter_type() ;
+		NumCh = Num ;
+		LastMin = -1 ;
+		return erSUCCESS ;
+	}
+
+	void deinit() {
+		if (psData) vRtosFree(psData) ;
+		psData = nullptr ;
+		NumCh = 0 ;
+	}
+
+	/**
+	 * Forced inline so the C wrapper is the only copy, keeping it within the size of counter.c
+	 * @return	-1 = repeat call this minute, 0 = update done
+	 */
+	[[gnu::always_inline]] int update(const struct tm & sTM) {
+		if (sTM.tm_sec != 0 || sTM.tm_min == LastMin)
+			return -1 ;
+		LastMin = sTM.tm_min ;
+		const bool bTrim = counter_type::trimming(sTM) ;
+		for (int i = 0; i < NumCh; ++i)
+			psData[i].rollover(sTM, bTrim) ;
+		return 0 ;
+	}
+
+	[[gnu::always_inline]] int increment(int Idx) {
+		if (OUTSIDE(0, Idx, NumCh-1)) return erFAILURE ;
+		psData[Idx].increment() ;
+		return erSUCCESS ;
+	}
+
+	int read(int Idx, int Tier, int Slot, u32_t * pu32) const {
+		if (OUTSIDE(0, Idx, NumCh-1) || Tier < 0 || Slot < 0 || pu32 == nullptr) return erFAILURE ;
+		return psData[Idx].read(Tier, Slot, *pu32) ? erSUCCESS : erFAILURE ;
+	}
+
+	counter_type & operator[](int Idx) { return psData[Idx] ; }
+} ;
+
+} // namespace pcnt
+
+/**
+ * Instantiate engine type E as a single static object and expose it to C as
+ *	int xN##Init(int), void vN##Deinit(void), int xN##Update(struct tm *), int xN##Increment(int)
+ *	and int xN##Read(int Idx, int Tier, int Slot, u32_t *), declare with pcntENGINE_C_DECL()
+ */
+#define	pcntENGINE_C_API(N, E)															\
+	static E s##N ;																		\
+	extern "C" int x##N##Init(int NumCh) { return s##N.init(NumCh) ; }					\
+	extern "C" void v##N##Deinit(void) { s##N.deinit() ; }								\
+	extern "C" int x##N##Update(struct tm * psTM) { return s##N.update(*psTM) ; }		\
+	extern "C" int x##N##Increment(int Idx) { return s##N.increment(Idx) ; }			\
+	extern "C" int x##N##Read(int Idx, int Tier, int Slot, u32_t * pu32) { return s##N.read(Idx, Tier, Slot, pu32) ; }
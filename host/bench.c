@@ -0,0 +1,41 @@
+/*
+ * bench.c - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host benchmark, xPulseCountBench() over a range of channel counts
+ *	counter_bench [channels ...]	default 1 8 32 64 128 255
+ */
+
+#include "counter.h"
+#include "x_errors_events.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const int BenchCh[] = { 1, 8, 32, 64, 128, 255 } ;
+
+static int xBenchRun(int NumCh) {
+	pcntbench_t sBench ;
+	if (xPulseCountBench(NumCh, &sBench) != erSUCCESS) {
+		fprintf(stderr, "bench failed with %d channels\n", NumCh) ;
+		return erFAILURE ;
+	}
+	printf("%4d %8u", NumCh, sBench.IncNs) ;
+	for (int p = 0; p < pcntPHASE_NUM; ++p)
+		printf(" %7u", sBench.UpdUs[p]) ;
+	printf(" %8u %8u %8u %8u\n", sBench.RenderNs, sBench.RenderNs ? 1000000000U / sBench.RenderNs : 0,
+			sBench.JsonNs, sBench.CborNs) ;
+	return erSUCCESS ;
+}
+
+int main(int argc, char * argv[]) {
+	int iRV = erSUCCESS ;
+	printf("  Ch   Inc ns  Min us Hour us  Day us MEnd us  Mon us Year us  Rend ns    Ch/s  JSON ns  CBOR ns\n") ;
+	if (argc > 1) {
+		for (int i = 1; i < argc; ++i)
+			if (xBenchRun(atoi(argv[i])) != erSUCCESS) iRV = erFAILURE ;
+	} else {
+		for (size_t i = 0; i < sizeof(BenchCh) / sizeof(BenchCh[0]); ++i)
+			if (xBenchRun(BenchCh[i]) != erSUCCESS) iRV = erFAILURE ;
+	}
+	return iRV == erSUCCESS ? EXIT_SUCCESS : EXIT_FAILURE ;
+}
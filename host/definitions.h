@@ -0,0 +1,33 @@
+/*
+ * definitions.h - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host stand-in, only what the counter component uses
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t		u8_t ;
+typedef uint16_t	u16_t ;
+typedef uint32_t	u32_t ;
+typedef uint64_t	u64_t ;
+typedef int8_t		i8_t ;
+typedef int16_t		i16_t ;
+typedef int32_t		i32_t ;
+typedef int64_t		i64_t ;
+
+#ifndef debugFLAG_GLOBAL
+	#define	debugFLAG_GLOBAL		0
+#endif
+
+#define	SECONDS_IN_MINUTE			60
+#define	MINUTES_IN_HOUR				60
+#define	HOURS_IN_DAY				24
+#define	DAYS_IN_MONTH_MAX			31
+#define	MONTHS_IN_YEAR				12
+
+#define	OUTSIDE(min, val, max)		(((val) < (min)) || ((val) > (max)))
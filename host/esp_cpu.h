@@ -0,0 +1,19 @@
+/*
+ * esp_cpu.h - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host stand-in, nanoseconds from the monotonic clock in place of CPU cycles
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+}
+#endif
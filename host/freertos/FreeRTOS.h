@@ -0,0 +1,13 @@
+/*
+ * FreeRTOS.h - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host stand-in, single threaded so critical sections are empty
+ */
+
+#pragma once
+
+typedef int portMUX_TYPE ;
+
+#define	portMUX_INITIALIZER_UNLOCKED	0
+#define	portENTER_CRITICAL_SAFE(pMux)	(void) (pMux)
+#define	portEXIT_CRITICAL_SAFE(pMux)	(void) (pMux)
@@ -0,0 +1,108 @@
+/*
+ * gate.c - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host performance gate, best of several xPulseCountBench() runs against a stored baseline
+ *	counter_gate <baseline>			fail if any measurement regressed beyond the baseline percent
+ *	counter_gate -w <baseline>		measure and write a new baseline
+ */
+
+#include "counter.h"
+#include "x_errors_events.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define	gateRUNS					5				// best of, to suppress scheduling noise
+#define	gateCHANNELS				64
+#define	gatePERCENT					50
+
+static const char * const pcPhase[pcntPHASE_NUM] = { "min", "hour", "day", "mend", "mon", "year" } ;
+
+static u32_t xGateMin(u32_t Best, u32_t Now, int Run) { return (Run == 0 || Now < Best) ? Now : Best ; }
+
+static int xGateMeasure(int NumCh, pcntbench_t * psBest) {
+	pcntbench_t sNow ;
+	for (int r = 0; r < gateRUNS; ++r) {
+		if (xPulseCountBench(NumCh, &sNow) != erSUCCESS) return erFAILURE ;
+		psBest->IncNs = xGateMin(psBest->IncNs, sNow.IncNs, r) ;
+		psBest->RenderNs = xGateMin(psBest->RenderNs, sNow.RenderNs, r) ;
+		psBest->JsonNs = xGateMin(psBest->JsonNs, sNow.JsonNs, r) ;
+		psBest->CborNs = xGateMin(psBest->CborNs, sNow.CborNs, r) ;
+		for (int p = 0; p < pcntPHASE_NUM; ++p)
+			psBest->UpdUs[p] = xGateMin(psBest->UpdUs[p], sNow.UpdUs[p], r) ;
+	}
+	return erSUCCESS ;
+}
+
+static void vGateWrite(FILE * psF, int NumCh, int Percent, const pcntbench_t * psB) {
+	fprintf(psF, "# xPulseCountBench() best of %d runs, host Release build\n", gateRUNS) ;
+	fprintf(psF, "# regenerate with: counter_gate -w <this file>\n") ;
+	fprintf(psF, "channels %d\npercent %d\ninc_ns %u\nrender_ns %u\njson_ns %u\ncbor_ns %u\n", NumCh, Percent,
+			psB->IncNs, psB->RenderNs, psB->JsonNs, psB->CborNs) ;
+	for (int p = 0; p < pcntPHASE_NUM; ++p)
+		fprintf(psF, "upd_us_%s %u\n", pcPhase[p], psB->UpdUs[p]) ;
+}
+
+static int xGateRead(FILE * psF, int * pNumCh, int * pPercent, pcntbench_t * psB) {
+	char caLine[128], caKey[32] ;
+	unsigned Val ;
+	int Found = 0 ;
+	while (fgets(caLine, sizeof(caLine), psF)) {
+		if (caLine[0] == '#' || sscanf(caLine, "%31s %u", caKey, &Val) != 2) continue ;
+		++Found ;
+		if (strcmp(caKey, "channels") == 0)			*pNumCh = Val ;
+		else if (strcmp(caKey, "percent") == 0)		*pPercent = Val ;
+		else if (strcmp(caKey, "inc_ns") == 0)		psB->IncNs = Val ;
+		else if (strcmp(caKey, "render_ns") == 0)	psB->RenderNs = Val ;
+		else if (strcmp(caKey, "json_ns") == 0)		psB->JsonNs = Val ;
+		else if (strcmp(caKey, "cbor_ns") == 0)		psB->CborNs = Val ;
+		else {
+			int p = 0 ;
+			while (p < pcntPHASE_NUM && (strncmp(caKey, "upd_us_", 7) || strcmp(caKey + 7, pcPhase[p]))) ++p ;
+			if (p == pcntPHASE_NUM) return erFAILURE ;
+			psB->UpdUs[p] = Val ;
+		}
+	}
+	return (Found == 6 + pcntPHASE_NUM) ? erSUCCESS : erFAILURE ;
+}
+
+static void vGatePrint(const char * pcName, const pcntbench_t * psB) {
+	printf("%-8s inc %u ns  render %u ns  json %u ns  cbor %u ns  update us", pcName, psB->IncNs,
+			psB->RenderNs, psB->JsonNs, psB->CborNs) ;
+	for (int p = 0; p < pcntPHASE_NUM; ++p)
+		printf(" %s=%u", pcPhase[p], psB->UpdUs[p]) ;
+	printf("\n") ;
+}
+
+int main(int argc, char * argv[]) {
+	bool bWrite = (argc == 3 && strcmp(argv[1], "-w") == 0) ;
+	if (argc != 2 && !bWrite) {
+		fprintf(stderr, "usage: %s [-w] <baseline>\n", argv[0]) ;
+		return EXIT_FAILURE ;
+	}
+	const char * pcFile = argv[argc - 1] ;
+	int NumCh = gateCHANNELS, Percent = gatePERCENT ;
+	pcntbench_t sBase = { 0 }, sNow = { 0 } ;
+	FILE * psF = fopen(pcFile, bWrite ? "w" : "r") ;
+	if (psF == NULL) {
+		perror(pcFile) ;
+		return EXIT_FAILURE ;
+	}
+	if (!bWrite && xGateRead(psF, &NumCh, &Percent, &sBase) != erSUCCESS) {
+		fprintf(stderr, "%s: invalid baseline\n", pcFile) ;
+		fclose(psF) ;
+		return EXIT_FAILURE ;
+	}
+	int iRV = xGateMeasure(NumCh, &sNow) ;
+	if (iRV == erSUCCESS && bWrite) {
+		vGateWrite(psF, NumCh, Percent, &sNow) ;
+	} else if (iRV == erSUCCESS) {
+		vGatePrint("baseline", &sBase) ;
+		vGatePrint("now", &sNow) ;
+		iRV = xPulseCountBenchCheck(&sBase, &sNow, Percent) ;
+		printf("%s, %d%% allowed\n", iRV == erSUCCESS ? "OK" : "REGRESSED", Percent) ;
+	}
+	fclose(psF) ;
+	return iRV == erSUCCESS ? EXIT_SUCCESS : EXIT_FAILURE ;
+}
@@ -0,0 +1,31 @@
+/*
+ * hal_platform.h - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host stand-in, only what the counter component uses
+ */
+
+#pragma once
+
+#include "definitions.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct { u64_t usecs ; } tsz_t ;
+
+extern tsz_t sTSZ ;
+
+static inline void * pvRtosMalloc(size_t Size) { return malloc(Size) ; }
+static inline void vRtosFree(void * pV) { free(pV) ; }
+
+int xTimeCalcDaysInMonth(struct tm * psTM);
+struct tm * xTimeGMTime(u32_t Secs, struct tm * psTM, int Flag);
+u32_t xTimeStampSeconds(u64_t uSecs);
+
+#ifdef __cplusplus
+}
+#endif
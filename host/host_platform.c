@@ -0,0 +1,83 @@
+/*
+ * host_platform.c - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host stand-in implementations of the platform functions used by the counter component
+ */
+
+#include "hal_platform.h"
+#include "printfx.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// ############################################ Globals ############################################
+
+tsz_t sTSZ ;
+
+// ############################################# Time ##############################################
+
+int xTimeCalcDaysInMonth(struct tm * psTM) {
+	static const u8_t DIM[MONTHS_IN_YEAR] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 } ;
+	int Year = psTM->tm_year + 1900 ;
+	bool bLeap = (Year % 4 == 0 && Year % 100 != 0) || Year % 400 == 0 ;
+	return DIM[psTM->tm_mon] + (psTM->tm_mon == 1 && bLeap) ;
+}
+
+struct tm * xTimeGMTime(u32_t Secs, struct tm * psTM, int Flag) {
+	(void) Flag ;
+	time_t tSecs = Secs ;
+	return gmtime_r(&tSecs, psTM) ;
+}
+
+u32_t xTimeStampSeconds(u64_t uSecs) { return uSecs / 1000000ULL ; }
+
+static u64_t xHostNanoSecs(void) {
+	struct timespec sTS ;
+	clock_gettime(CLOCK_MONOTONIC, &sTS) ;
+	return (u64_t) sTS.tv_sec * 1000000000ULL + sTS.tv_nsec ;
+}
+
+int64_t esp_timer_get_time(void) { return xHostNanoSecs() / 1000 ; }
+
+uint32_t esp_cpu_get_cycle_count(void) { return (u32_t) xHostNanoSecs() ; }
+
+// ############################################ Output #############################################
+
+u32_t xpfSGR(u8_t a1, u8_t a2, u8_t a3, u8_t a4) {
+	return ((u32_t) a4 << 24) | ((u32_t) a3 << 16) | ((u32_t) a2 << 8) | a1 ;
+}
+
+int printfx(const char * pcFmt, ...) {
+	va_list vaList ;
+	va_start(vaList, pcFmt) ;
+	int iRV = vprintf(pcFmt, vaList) ;
+	va_end(vaList) ;
+	return iRV ;
+}
+
+int snprintfx(char * pBuf, size_t Size, const char * pcFmt, ...) {
+	va_list vaList ;
+	va_start(vaList, pcFmt) ;
+	size_t Len = 0 ;
+	char caSGR[24] ;
+	for (; *pcFmt; ++pcFmt) {
+		const char * pcSrc = pcFmt ;
+		int Num = 1 ;
+		if (pcFmt[0] == '%' && pcFmt[1] == 'C') {		// ESC[a1;a2;a3;a4m, zero a2..a4 omitted
+			u32_t SGR = va_arg(vaList, u32_t) ;
+			Num = snprintf(caSGR, sizeof(caSGR), "\033[%u", SGR & 0xFF) ;
+			for (SGR >>= 8; SGR; SGR >>= 8)
+				if (SGR & 0xFF) Num += snprintf(caSGR + Num, sizeof(caSGR) - Num, ";%u", SGR & 0xFF) ;
+			caSGR[Num++] = 'm' ;
+			pcSrc = caSGR ;
+			++pcFmt ;
+		}
+		for (int i = 0; i < Num; ++i, ++Len)
+			if (Len + 1 < Size) pBuf[Len] = pcSrc[i] ;
+	}
+	if (Size) pBuf[Len < Size ? Len : Size - 1] = 0 ;
+	va_end(vaList) ;
+	return Len ;
+}
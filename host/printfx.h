@@ -0,0 +1,27 @@
+/*
+ * printfx.h - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host stand-in, only what the counter component uses. snprintfx() handles text and %C only
+ */
+
+#pragma once
+
+#include "definitions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define	attrRESET					0
+#define	colourFG_CYAN				36
+
+#define	PL(f, ...)					printfx(f, ##__VA_ARGS__)
+#define	IF_PL(t, f, ...)			if (t) PL(f, ##__VA_ARGS__)
+
+u32_t xpfSGR(u8_t a1, u8_t a2, u8_t a3, u8_t a4);
+int printfx(const char * pcFmt, ...);
+int snprintfx(char * pBuf, size_t Size, const char * pcFmt, ...);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+/*
+ * replay.c - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host differential test, xPulseCountReplay() over normal & leap years and xPulseCountFuzz()
+ * over a set of seeds, every persisted bucket checked against the reference model and, for
+ * the years, against PulseEngine
+ *	counter_replay [seeds [steps]]	default 32 seeds of 20000 steps
+ */
+
+#include "counter.h"
+#include "x_errors_events.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const int ReplayYear[] = { 2023, 2024, 2100 } ;	// normal, leap & century non leap
+
+static int xReplayReport(const char * pcName, u32_t Arg, int iRV, const pcntreplay_t * psRes) {
+	printf("%-6s %10u %8u min %10u pulses %8u clipped %6llu ms", pcName, Arg, psRes->Minutes,
+			psRes->Pulses, psRes->Clipped, (unsigned long long) psRes->WallUs / 1000) ;
+	if (iRV == erSUCCESS) {
+		printf("  OK\n") ;
+	} else {
+		printf("  FAIL %u mismatches, first at minute %u, %u rewrites", psRes->Mismatch, psRes->FirstBad, psRes->Rewrite) ;
+		if (psRes->Engine) printf(", %u engine differences, first at minute %u", psRes->Engine, psRes->FirstEngine) ;
+		printf("\n") ;
+	}
+	return iRV ;
+}
+
+int main(int argc, char * argv[]) {
+	u32_t Seeds = (argc > 1) ? strtoul(argv[1], NULL, 0) : 32 ;
+	u32_t Steps = (argc > 2) ? strtoul(argv[2], NULL, 0) : 20000 ;
+	pcntreplay_t sRes ;
+	int iRV = erSUCCESS ;
+	for (size_t i = 0; i < sizeof(ReplayYear) / sizeof(ReplayYear[0]); ++i)
+		if (xReplayReport("year", ReplayYear[i], xPulseCountReplay(16, ReplayYear[i], NULL, &sRes), &sRes) != erSUCCESS)
+			iRV = erFAILURE ;
+	for (u32_t Seed = 1; Seed <= Seeds; ++Seed)
+		if (xReplayReport("seed", Seed, xPulseCountFuzz(1 + Seed % 8, Seed, Steps, &sRes), &sRes) != erSUCCESS)
+			iRV = erFAILURE ;
+	return iRV == erSUCCESS ? EXIT_SUCCESS : EXIT_FAILURE ;
+}
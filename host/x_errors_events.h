@@ -0,0 +1,10 @@
+/*
+ * x_errors_events.h - Copyright (c) 2022-24 Andre M. Maree / KSS Technologies (Pty) Ltd.
+ *
+ * Host stand-in, only what the counter component uses
+ */
+
+#pragma once
+
+#define	erSUCCESS					0
+#define	erFAILURE					-1